@@ -1,10 +1,17 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
 #include <getopt.h>
 #include "field_loader.h"
 #include "dbscan.h"
+#include "density_analyzer.h"
+#include "surface_mesher.h"
+#include "symmetric_eigen.h"
 #include "spatial_structure_package.h"
+#include "spatial_graph.h"
 
 void printHelp() {
     std::cout << "AME Scanner CLI Tool" << std::endl;
@@ -15,6 +22,9 @@ void printHelp() {
     std::cout << "  -e, --epsilon FLOAT     DBSCAN epsilon parameter (default: 0.1)" << std::endl;
     std::cout << "  -m, --min-pts INT       DBSCAN min points parameter (default: 5)" << std::endl;
     std::cout << "  -f, --format FORMAT     Output format (default: ssp)" << std::endl;
+    std::cout << "  -d, --mesh-dir DIR      Write entity collision meshes (.amesh) to DIR" << std::endl;
+    std::cout << "  -g, --grid-size FLOAT   Density grid size for meshing (default: 0.1)" << std::endl;
+    std::cout << "  -i, --iso-level FLOAT   Density iso level for meshing (default: 0.5)" << std::endl;
     std::cout << "  -v, --verbose           Enable verbose output" << std::endl;
     std::cout << std::endl;
     std::cout << "Input formats supported: .ply, .splat" << std::endl;
@@ -25,6 +35,9 @@ int main(int argc, char** argv) {
     float epsilon = 0.1f;
     int min_pts = 5;
     std::string format = "ssp";
+    std::string mesh_dir;
+    float grid_size = 0.1f;
+    float iso_level = 0.5f;
     bool verbose = false;
     
     // Parse command line arguments
@@ -33,13 +46,16 @@ int main(int argc, char** argv) {
         {"epsilon", required_argument, 0, 'e'},
         {"min-pts", required_argument, 0, 'm'},
         {"format", required_argument, 0, 'f'},
+        {"mesh-dir", required_argument, 0, 'd'},
+        {"grid-size", required_argument, 0, 'g'},
+        {"iso-level", required_argument, 0, 'i'},
         {"verbose", no_argument, 0, 'v'},
         {0, 0, 0, 0}
     };
     
     int opt;
     int option_index = 0;
-    while ((opt = getopt_long(argc, argv, "he:m:f:v", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "he:m:f:d:g:i:v", long_options, &option_index)) != -1) {
         switch (opt) {
         case 'h':
             printHelp();
@@ -53,6 +69,15 @@ int main(int argc, char** argv) {
         case 'f':
             format = optarg;
             break;
+        case 'd':
+            mesh_dir = optarg;
+            break;
+        case 'g':
+            grid_size = std::stof(optarg);
+            break;
+        case 'i':
+            iso_level = std::stof(optarg);
+            break;
         case 'v':
             verbose = true;
             break;
@@ -79,6 +104,9 @@ int main(int argc, char** argv) {
         std::cout << "DBSCAN epsilon: " << epsilon << std::endl;
         std::cout << "DBSCAN min points: " << min_pts << std::endl;
         std::cout << "Output format: " << format << std::endl;
+        if (!mesh_dir.empty()) {
+            std::cout << "Mesh directory: " << mesh_dir << " (grid size " << grid_size << ", iso level " << iso_level << ")" << std::endl;
+        }
         std::cout << std::endl;
     }
     
@@ -134,6 +162,44 @@ int main(int argc, char** argv) {
     ssp.metadata.num_relationships = 0;
     ssp.metadata.processing_time_ms = 0.0f;
     
+    // Fit a PCA box to each cluster: covariances of all clusters are
+    // decomposed in one batch and the points projected onto the axes
+    const size_t num_clusters = clusters.size();
+    std::vector<Eigen::Vector3f> means(num_clusters, Eigen::Vector3f::Zero());
+    std::vector<float> packed(6 * num_clusters, 0.0f);
+    for (size_t i = 0; i < num_clusters; ++i) {
+        for (size_t idx : clusters[i]) {
+            means[i] += gaussians[idx].getPosition();
+        }
+        means[i] /= static_cast<float>(std::max<size_t>(clusters[i].size(), 1));
+        Eigen::Matrix3f covariance = Eigen::Matrix3f::Zero();
+        for (size_t idx : clusters[i]) {
+            Eigen::Vector3f offset = gaussians[idx].getPosition() - means[i];
+            covariance += offset * offset.transpose();
+        }
+        packed[0 * num_clusters + i] = covariance(0, 0);
+        packed[1 * num_clusters + i] = covariance(0, 1);
+        packed[2 * num_clusters + i] = covariance(0, 2);
+        packed[3 * num_clusters + i] = covariance(1, 1);
+        packed[4 * num_clusters + i] = covariance(1, 2);
+        packed[5 * num_clusters + i] = covariance(2, 2);
+    }
+    std::vector<float> eigenvalues(3 * num_clusters);
+    std::vector<float> eigenvectors(9 * num_clusters);
+    const float* packed_columns[6];
+    float* eigenvalue_columns[3];
+    float* eigenvector_columns[9];
+    for (int c = 0; c < 6; ++c) {
+        packed_columns[c] = packed.data() + c * num_clusters;
+    }
+    for (int k = 0; k < 3; ++k) {
+        eigenvalue_columns[k] = eigenvalues.data() + k * num_clusters;
+    }
+    for (int c = 0; c < 9; ++c) {
+        eigenvector_columns[c] = eigenvectors.data() + c * num_clusters;
+    }
+    AmeScanner::solveSymmetricEigen3(num_clusters, packed_columns, eigenvalue_columns, eigenvector_columns);
+    
     // Create entities from clusters
     for (size_t i = 0; i < clusters.size(); ++i) {
         AmeScanner::AmeEntity entity;
@@ -141,17 +207,102 @@ int main(int argc, char** argv) {
         entity.physics_handle = i;
         entity.metaclass = "unknown";
         
-        // Compute OBB for cluster
-        // TODO: Implement PCA-based OBB fitting
+        // Box axes are the covariance eigenvectors, largest first
         AmeScanner::OBB obb;
-        obb.center = Eigen::Vector3f::Zero();
-        obb.rotation = Eigen::Matrix3f::Identity();
-        obb.extents = Eigen::Vector3f::Ones();
+        for (int axis = 0; axis < 3; ++axis) {
+            const int k = 2 - axis;
+            for (int row = 0; row < 3; ++row) {
+                obb.rotation(row, axis) = eigenvectors[(3 * k + row) * num_clusters + i];
+            }
+        }
+        if (obb.rotation.determinant() < 0.0f) {
+            obb.rotation.col(2) = -obb.rotation.col(2);
+        }
+        Eigen::Vector3f local_min = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f local_max = -local_min;
+        for (size_t idx : clusters[i]) {
+            Eigen::Vector3f local = obb.rotation.transpose() * (gaussians[idx].getPosition() - means[i]);
+            local_min = local_min.cwiseMin(local);
+            local_max = local_max.cwiseMax(local);
+        }
+        obb.center = means[i] + obb.rotation * (0.5f * (local_min + local_max));
+        obb.extents = 0.5f * (local_max - local_min);
         entity.obb = obb;
         
         ssp.entities.push_back(entity);
     }
     
+    // Relate entities to their neighbors
+    AmeScanner::SpatialGraph graph;
+    graph.buildGraph(ssp.entities);
+    ssp.relationships = graph.getRelationships();
+    ssp.metadata.num_relationships = ssp.relationships.size();
+    
+    // Mesh the dense regions of the scene and give each entity the mesh of
+    // the region holding most of its gaussians
+    if (!mesh_dir.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(mesh_dir, error);
+        if (error) {
+            std::cerr << "Error: Failed to create mesh directory " << mesh_dir << std::endl;
+            return 1;
+        }
+        
+        AmeScanner::DensityAnalyzer analyzer(grid_size);
+        auto field = analyzer.computeSparseDensityField(gaussians);
+        std::vector<int32_t> voxel_labels;
+        auto regions = analyzer.labelDenseRegions(field, iso_level, &voxel_labels);
+        AmeScanner::SurfaceMesher mesher;
+        auto meshes = mesher.meshRegions(field, voxel_labels, regions.size(), iso_level);
+        
+        constexpr int kBrickSize = AmeScanner::SparseDensityField::kBrickSize;
+        auto regionAt = [&](const Eigen::Vector3f& point) -> int32_t {
+            Eigen::Vector3i voxel = ((point - field.getOrigin()) / field.getVoxelSize()).array().floor().cast<int>();
+            if ((voxel.array() < 0).any()) {
+                return -1;
+            }
+            int64_t brick = field.findBrick(voxel / kBrickSize);
+            if (brick == AmeScanner::SparseDensityField::kNoBrick) {
+                return -1;
+            }
+            Eigen::Vector3i local = voxel - (voxel / kBrickSize) * kBrickSize;
+            return voxel_labels[brick * AmeScanner::SparseDensityField::kBrickVoxels + (local.z() * kBrickSize + local.y()) * kBrickSize + local.x()];
+        };
+        
+        std::vector<std::string> mesh_paths(meshes.size());
+        for (size_t i = 0; i < clusters.size(); ++i) {
+            std::vector<size_t> votes(regions.size(), 0);
+            for (size_t g : clusters[i]) {
+                int32_t region = regionAt(gaussians[g].getPosition());
+                if (region >= 0) {
+                    votes[region]++;
+                }
+            }
+            auto best = std::max_element(votes.begin(), votes.end());
+            if (best == votes.end() || *best == 0) {
+                continue;  // Entity keeps its OBB proxy
+            }
+            
+            size_t region = best - votes.begin();
+            if (mesh_paths[region].empty()) {
+                std::string path = (std::filesystem::path(mesh_dir) / ("region_" + std::to_string(region) + ".amesh")).string();
+                if (!AmeScanner::SurfaceMesher::saveMesh(path, meshes[region])) {
+                    std::cerr << "Error: Failed to save mesh " << path << std::endl;
+                    return 1;
+                }
+                mesh_paths[region] = path;
+            }
+            ssp.entities[i].mesh_path = mesh_paths[region];
+        }
+        
+        if (verbose) {
+            size_t meshed = std::count_if(ssp.entities.begin(), ssp.entities.end(),
+                                          [](const AmeScanner::AmeEntity& entity) { return !entity.mesh_path.empty(); });
+            std::cout << "Meshed " << meshed << " of " << ssp.entities.size() << " entities into " << mesh_dir << std::endl;
+            std::cout << std::endl;
+        }
+    }
+    
     // Serialize SpatialStructurePackage
     if (!ssp.serialize(output_file)) {
         std::cerr << "Error: Failed to save Spatial Structure Package" << std::endl;
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <Eigen/Geometry>
+
+namespace AmeScanner {
+
+// Binary tree of axis-aligned boxes for broad-phase pair finding. Built
+// top-down by median splits along the longest axis of the box centers;
+// leaves hold up to kLeafSize items.
+class BoundingVolumeHierarchy {
+public:
+    static constexpr uint32_t kLeafSize = 4;
+    
+    BoundingVolumeHierarchy() = default;
+    
+    // Build over boxes; item ids are indices into boxes
+    void build(const std::vector<Eigen::AlignedBox3f>& boxes);
+    
+    // Give items new boxes and refit every node box bottom-up. The tree
+    // keeps its topology, so queries stay exact but slow down if boxes
+    // move far from where they were built; rebuild then.
+    void refit(const std::vector<uint32_t>& items, const std::vector<Eigen::AlignedBox3f>& boxes);
+    
+    size_t size() const { return boxes_.size(); }
+    const Eigen::AlignedBox3f& getBox(uint32_t item) const { return boxes_[item]; }
+    
+    // Call fn(item) for every item whose box intersects the query box
+    template <typename Fn>
+    void forEachOverlap(const Eigen::AlignedBox3f& query, Fn&& fn) const;
+    
+private:
+    // Nodes are stored in pre-order: an inner node's left child follows it
+    struct Node {
+        Eigen::AlignedBox3f box;
+        uint32_t first = 0;  // Leaf: first slot in items_; inner: right child
+        uint32_t count = 0;  // Items in a leaf, 0 for an inner node
+    };
+    
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> items_;  // Item ids in leaf order
+    std::vector<Eigen::AlignedBox3f> boxes_;
+    
+    // Helper methods
+    uint32_t buildNode(uint32_t begin, uint32_t end, const std::vector<Eigen::Vector3f>& centers);
+};
+
+template <typename Fn>
+void BoundingVolumeHierarchy::forEachOverlap(const Eigen::AlignedBox3f& query, Fn&& fn) const {
+    if (nodes_.empty()) {
+        return;
+    }
+    uint32_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes_[stack[--top]];
+        if (!node.box.intersects(query)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (uint32_t slot = node.first; slot < node.first + node.count; ++slot) {
+                if (boxes_[items_[slot]].intersects(query)) {
+                    fn(items_[slot]);
+                }
+            }
+        } else {
+            const uint32_t self = static_cast<uint32_t>(&node - nodes_.data());
+            stack[top++] = node.first;
+            stack[top++] = self + 1;
+        }
+    }
+}
+
+} // namespace AmeScanner
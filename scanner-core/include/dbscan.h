@@ -1,24 +1,65 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <span>
+#include <cstdint>
 #include <Eigen/Core>
 #include "gaussian.h"
+#include "spatial_hash_grid.h"
+#include "gaussian_attributes.h"
 
 namespace AmeScanner {
 
 class DBSCAN {
 public:
+    // Special label values; cluster ids are >= 0
+    static constexpr int32_t kUnvisited = -1;
+    static constexpr int32_t kNoise = -2;
+    static constexpr int32_t kFiltered = -3;  // Below the opacity floor, never indexed
+    
+    // How two gaussians are tested for being neighbors
+    enum class DistanceMode {
+        Euclidean,   // Center-to-center distance <= eps
+        Anisotropic  // Also neighbors if either center lies inside the other's ellipsoid
+    };
+    
+    // What a point's neighborhood is measured in for the core test
+    enum class NeighborWeighting {
+        Count,       // Number of neighbors >= min_pts
+        OpacityMass  // Summed neighbor opacity >= min_mass
+    };
+    
     DBSCAN(float eps = 0.1f, int min_pts = 5) : eps_(eps), min_pts_(min_pts) {}
     
-    // Set parameters
+    // Set parameters (takes effect on the next call to cluster())
     void setEpsilon(float eps) { eps_ = eps; }
     void setMinPoints(int min_pts) { min_pts_ = min_pts; }
+    void setDistanceMode(DistanceMode mode) { distance_mode_ = mode; }
+    // Ellipsoid size in standard deviations for the anisotropic test
+    void setMahalanobisThreshold(float sigmas) { mahalanobis_threshold_ = sigmas; }
+    // Caps the ellipsoid bounding radius so huge splats cannot blow up the
+    // query radius; <= 0 means 4 * eps
+    void setMaxSplatRadius(float radius) { max_splat_radius_ = radius; }
+    // Gaussians with opacity below the floor are dropped before indexing
+    void setOpacityFloor(float opacity) { opacity_floor_ = opacity; }
+    void setNeighborWeighting(NeighborWeighting weighting) { weighting_ = weighting; }
+    void setMinMass(float min_mass) { min_mass_ = min_mass; }
     
     // Cluster gaussians
     std::vector<std::vector<size_t>> cluster(const std::vector<Gaussian>& gaussians);
     
+    // Append a batch of gaussians to the clustered scene. Only points within
+    // eps of the batch are revisited; clusters that do not touch the batch
+    // keep their ids. New points are indexed after all previous ones.
+    void insert(std::span<const Gaussian> gaussians);
+    
+    // Get clusters by id. Ids absorbed by a merge during insert() are left
+    // empty so that the surviving ids never shift.
+    const std::vector<std::vector<size_t>>& getClusters() const { return clusters_; }
+    
     // Get cluster labels
-    const std::vector<int>& getLabels() const { return labels_; }
+    const std::vector<int32_t>& getLabels() const { return labels_; }
     
     // Get number of clusters
     int getNumClusters() const { return num_clusters_; }
@@ -26,18 +67,70 @@ public:
     // Get number of noise points
     int getNumNoise() const { return num_noise_; }
     
+    // Get number of points removed by the opacity floor
+    int getNumFiltered() const { return num_filtered_; }
+    
 private:
+    // Per-thread buffers reused across regionQuery/expandCluster calls
+    struct Scratch {
+        std::vector<uint32_t> neighbors;  // Result of the last region query
+        std::vector<uint32_t> frontier;   // Points waiting to be expanded
+        std::vector<uint64_t> queued;     // Bitset: point already entered a frontier
+        
+        // Anisotropic candidates that passed the sphere test, as SoA
+        std::vector<uint32_t> candidates;
+        std::vector<float> dx, dy, dz;
+        std::vector<float> inv_cov[6];
+        std::vector<uint8_t> accepted;
+    };
+    
     float eps_;          // Maximum distance between two points to be considered neighbors
     int min_pts_;        // Minimum number of points required to form a cluster
+    DistanceMode distance_mode_ = DistanceMode::Euclidean;
+    DistanceMode active_mode_ = DistanceMode::Euclidean;  // Mode the current index was built with
+    float mahalanobis_threshold_ = 3.0f;
+    float max_splat_radius_ = 0.0f;
+    float opacity_floor_ = 0.0f;
+    NeighborWeighting weighting_ = NeighborWeighting::Count;
+    float min_mass_ = 1.0f;
+    
+    // The index and shape table only hold points above the opacity floor;
+    // index rows map to point ids through point_ids_. Everything else is
+    // addressed by point id.
+    SpatialHashGrid index_;
+    std::vector<uint32_t> point_ids_;          // Index row -> point id
+    std::vector<uint32_t> rows_;               // Point id -> index row
+    std::vector<float> opacities_;             // Opacity per point id
+    std::vector<float> neighbor_weights_;      // Neighbor count or mass, excluding self
+    
+    // Anisotropic mode: per-gaussian inverse covariances and bounding radii
+    GaussianAttributeTable shape_;
+    float radius_cap_ = 0.0f;           // Effective max splat radius
+    float max_bounding_radius_ = 0.0f;  // Largest capped bounding radius
     
-    std::vector<int> labels_;    // Cluster labels for each point
-    int num_clusters_;           // Number of clusters found
-    int num_noise_;              // Number of noise points
+    std::vector<int32_t> labels_;               // Cluster labels for each point
+    std::vector<std::vector<size_t>> clusters_; // Member points of each cluster id
+    int num_clusters_ = 0;                      // Number of clusters found
+    int num_noise_ = 0;                         // Number of noise points
+    int num_filtered_ = 0;                      // Number of points below the opacity floor
     
     // Helper methods
-    std::vector<size_t> regionQuery(const std::vector<Gaussian>& gaussians, size_t point_idx);
-    void expandCluster(const std::vector<Gaussian>& gaussians, size_t point_idx, std::vector<size_t>& neighbors, int cluster_id);
-    float computeDistance(const Gaussian& a, const Gaussian& b);
+    static Scratch& threadScratch();
+    void regionQuery(uint32_t point_idx, std::vector<uint32_t>& neighbors) const;
+    void anisotropicRegionQuery(uint32_t point_idx, std::vector<uint32_t>& neighbors) const;
+    float cappedRadius(uint32_t row) const { return std::min(shape_.getBoundingRadii()[row], radius_cap_); }
+    void expandCluster(Scratch& scratch, int32_t cluster_id);
+    void addPoints(std::span<const Gaussian> gaussians);
+    float neighborWeight(uint32_t point_idx) const {
+        return weighting_ == NeighborWeighting::Count ? 1.0f : opacities_[point_idx];
+    }
+    float sumNeighborWeights(const std::vector<uint32_t>& neighbors) const;
+    bool isCore(uint32_t point_idx) const {
+        float threshold = weighting_ == NeighborWeighting::Count ? static_cast<float>(min_pts_) : min_mass_;
+        return neighbor_weights_[point_idx] >= threshold;
+    }
+    void assignPoint(uint32_t point_idx, int32_t cluster_id);
+    int32_t mergeClusters(int32_t a, int32_t b);
 };
 
 } // namespace AmeScanner
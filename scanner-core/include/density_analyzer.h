@@ -1,18 +1,38 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <span>
+#include <limits>
+#include <cstdint>
 #include <Eigen/Core>
 #include "gaussian.h"
+#include "density_kernel.h"
+#include "sparse_density_field.h"
 
 namespace AmeScanner {
 
 class DensityAnalyzer {
 public:
+    // How a gaussian's density falls off around its center
+    enum class KernelMode {
+        Isotropic,   // Sphere with sigma = mean scale
+        Anisotropic  // Full covariance ellipsoid
+    };
+    
     DensityAnalyzer(float grid_size = 0.1f) : grid_size_(grid_size) {}
     
     // Set grid size for density analysis
     void setGridSize(float grid_size) { grid_size_ = grid_size; }
     
+    // Gaussians contribute only within this many standard deviations
+    void setCutoffSigmas(float sigmas) { cutoff_sigmas_ = sigmas; }
+    
+    void setKernelMode(KernelMode mode) { kernel_mode_ = mode; }
+    
+    // Bricks whose densities all stay at or below epsilon are not stored
+    void setSparseEpsilon(float epsilon) { sparse_epsilon_ = epsilon; }
+    
     // Compute density field from gaussians
     std::vector<float> computeDensityField(
         const std::vector<Gaussian>& gaussians,
@@ -21,9 +41,18 @@ public:
         Eigen::Vector3i& grid_dims
     );
     
-    // Compute density at a specific point
+    // Compute the density field as sparse bricks; memory follows the occupied
+    // volume, and statistics cover the stored voxels only
+    SparseDensityField computeSparseDensityField(const std::vector<Gaussian>& gaussians);
+    
+    // Compute density at a specific point, using the same cutoff as the field.
+    // Each call prepares the kernel data for all gaussians; use
+    // computeDensityAtPoints to query many points.
     float computeDensityAtPoint(const std::vector<Gaussian>& gaussians, const Eigen::Vector3f& point);
     
+    // Density at each of points, preparing the kernel data once
+    std::vector<float> computeDensityAtPoints(const std::vector<Gaussian>& gaussians, std::span<const Eigen::Vector3f> points);
+    
     // Find dense regions in the density field
     std::vector<Eigen::Vector3f> findDenseRegions(
         const std::vector<float>& density_field,
@@ -31,27 +60,135 @@ public:
         const Eigen::Vector3i& grid_dims,
         float density_threshold
     );
+    std::vector<Eigen::Vector3f> findDenseRegions(const SparseDensityField& field, float density_threshold);
+    
+    // Number of voxels at or above the threshold; cheap enough for threshold
+    // sweeps since the field's pyramid skips bricks that cannot qualify
+    size_t countDenseVoxels(const SparseDensityField& field, float density_threshold) const;
+    
+    // Connected set of voxels at or above a density threshold
+    struct DenseRegion {
+        size_t voxel_count = 0;
+        Eigen::Vector3f min_bounds = Eigen::Vector3f::Zero();  // Outer corners of the voxels
+        Eigen::Vector3f max_bounds = Eigen::Vector3f::Zero();
+        float mass = 0.0f;                                     // Density integrated over the voxels
+        Eigen::Vector3f centroid = Eigen::Vector3f::Zero();    // Density-weighted center
+    };
+    
+    // Label 6-connected voxels at or above the threshold. Regions are ordered
+    // by their first voxel in storage order. If voxel_labels is given it
+    // receives a region index per voxel (per stored voxel for the sparse
+    // field, per grid voxel for the dense one), or -1 below the threshold.
+    std::vector<DenseRegion> labelDenseRegions(
+        const SparseDensityField& field,
+        float density_threshold,
+        std::vector<int32_t>* voxel_labels = nullptr
+    );
+    std::vector<DenseRegion> labelDenseRegions(
+        const std::vector<float>& density_field,
+        const Eigen::Vector3f& min_bounds,
+        const Eigen::Vector3i& grid_dims,
+        float density_threshold,
+        std::vector<int32_t>* voxel_labels = nullptr
+    );
+    
+    // Write a field, its bounds and the statistics of the last analysis to a
+    // file that MappedDensityField can open without recomputing anything.
+    // The dense overload stores the grid as bricks, skipping all-zero ones.
+    bool saveDensityField(const std::string& file_path, const SparseDensityField& field) const;
+    bool saveDensityField(
+        const std::string& file_path,
+        const std::vector<float>& density_field,
+        const Eigen::Vector3f& min_bounds,
+        const Eigen::Vector3f& max_bounds,
+        const Eigen::Vector3i& grid_dims
+    ) const;
     
-    // Get density statistics
+    // Get density statistics. Median and percentiles come from a histogram
+    // with 128 bins per power of two, so they are accurate to about 1%.
     struct Statistics {
-        float min_density;
-        float max_density;
-        float mean_density;
-        float median_density;
-        float std_dev_density;
+        float min_density = 0.0f;
+        float max_density = 0.0f;
+        float mean_density = 0.0f;
+        float median_density = 0.0f;
+        float p90_density = 0.0f;
+        float p99_density = 0.0f;
+        float std_dev_density = 0.0f;
     };
     
     const Statistics& getStatistics() const { return stats_; }
     
+    // Density below which a fraction q in [0, 1] of the last analyzed field lies
+    float getPercentile(float q) const;
+    
 private:
     float grid_size_;
+    float cutoff_sigmas_ = 3.0f;
+    KernelMode kernel_mode_ = KernelMode::Isotropic;
+    float sparse_epsilon_ = 1e-6f;
     Statistics stats_;
+    std::vector<uint64_t> histogram_;  // Counts of the last analyzed field
+    
+    // Histogram bins are the top bits of the order-preserving float key
+    static constexpr int kHistogramBits = 16;
+    static constexpr size_t kHistogramBins = size_t(1) << kHistogramBits;
+    
+    // Streaming count, mean, M2 (Welford) and range of a run of values
+    struct Moments {
+        size_t count = 0;
+        double mean = 0.0;
+        double m2 = 0.0;
+        float min = std::numeric_limits<float>::max();
+        float max = std::numeric_limits<float>::lowest();
+        
+        void add(float value);
+        void merge(const Moments& other);
+    };
+    
+    // Edge length, in voxels, of the tiles processed by one worker
+    static constexpr int kTileSize = 16;
     
     // Helper methods
     Eigen::Vector3i getGridIndex(const Eigen::Vector3f& point, const Eigen::Vector3f& min_bounds) const;
     size_t getLinearIndex(const Eigen::Vector3i& grid_index, const Eigen::Vector3i& grid_dims) const;
     Eigen::Vector3f getGridCenter(const Eigen::Vector3i& grid_index, const Eigen::Vector3f& min_bounds) const;
-    void computeStatistics(const std::vector<float>& density_field);
+    void computeStatistics(std::span<const float> density_field);
+    void computeBounds(
+        const std::vector<Gaussian>& gaussians,
+        Eigen::Vector3f& min_bounds,
+        Eigen::Vector3f& max_bounds,
+        Eigen::Vector3i& grid_dims
+    ) const;
+    void buildSparseField(
+        const std::vector<Gaussian>& gaussians,
+        const Eigen::Vector3f& min_bounds,
+        const Eigen::Vector3i& grid_dims,
+        SparseDensityField& field
+    ) const;
+    std::vector<size_t> gatherDenseBricks(
+        const std::vector<float>& density_field,
+        const Eigen::Vector3f& min_bounds,
+        const Eigen::Vector3i& grid_dims,
+        float min_value,
+        SparseDensityField& field
+    ) const;
+    bool writeDensityFieldFile(
+        const std::string& file_path,
+        const SparseDensityField& field,
+        const Eigen::Vector3f& max_bounds
+    ) const;
+    static size_t histogramBin(float value);
+    static float histogramBinStart(size_t bin);
+    static uint64_t packTileKey(const Eigen::Vector3i& tile);
+    static Eigen::Vector3i unpackTileKey(uint64_t key);
+    bool computeFootprint(
+        const Eigen::Vector3f& center,
+        const Eigen::Vector3f& half_extent,
+        const Eigen::Vector3f& min_bounds,
+        const Eigen::Vector3i& grid_dims,
+        Eigen::Vector3i& lo,
+        Eigen::Vector3i& hi
+    ) const;
 };
 
 } // namespace AmeScanner
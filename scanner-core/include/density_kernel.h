@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include "gaussian.h"
+#include "gaussian_attributes.h"
+
+namespace AmeScanner {
+
+// Isotropic density parameters for a set of gaussians, as SoA. The
+// falloff of gaussian i at squared distance d2 is
+// opacity[i] * exp(-d2 * inv_two_sigma_sq[i]) for d2 <= cutoff_sq[i].
+struct IsotropicKernelData {
+    std::vector<float> x, y, z;
+    std::vector<float> opacity;
+    std::vector<float> inv_two_sigma_sq;
+    std::vector<float> cutoff_sq;
+    
+    // Gaussians with a non-positive mean scale get a zero cutoff
+    void build(std::span<const Gaussian> gaussians, float cutoff_sigmas);
+    size_t size() const { return x.size(); }
+};
+
+// exp(x) for x <= 0 via Cody-Waite range reduction and a degree-6
+// polynomial; relative error below 3e-7 on [-87, 0]. Plain arithmetic
+// only, so loops calling it vectorize.
+inline float fastExp(float x) {
+    x = x < -87.0f ? -87.0f : x;
+    
+    // n = round(x / ln2) using the 1.5 * 2^23 rounding trick
+    const float kShift = 12582912.0f;
+    float shifted = x * 1.44269504088896341f + kShift;
+    float n = shifted - kShift;
+    int32_t shifted_bits;
+    std::memcpy(&shifted_bits, &shifted, sizeof(shifted_bits));
+    int32_t exponent = shifted_bits - 0x4B400000;
+    
+    float r = x - n * 0.693359375f + n * 2.12194440e-4f;
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    
+    int32_t scale_bits = (exponent + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scale_bits, sizeof(scale));
+    return p * scale;
+}
+
+// Density at (px, py, pz) from gaussians [0, count) of data
+float evaluateIsotropicDensity(
+    size_t count,
+    const float* x, const float* y, const float* z,
+    const float* opacity, const float* inv_two_sigma_sq, const float* cutoff_sq,
+    float px, float py, float pz
+);
+
+// Edge length of the voxel blocks filled by accumulateBlockDensity
+constexpr int kDensityBlockSize = 16;
+
+// Adds gaussian `index` of data to a kDensityBlockSize^3 block stored
+// x-fastest, whose voxel (x, y, z) is centered at origin + (x, y, z) * spacing.
+// Only rows with y in [y_lo, y_hi] and z in [z_lo, z_hi] are visited; each
+// row is evaluated as one vector across its voxels.
+void accumulateBlockDensity(
+    const IsotropicKernelData& data, size_t index,
+    const float origin[3], float spacing,
+    int y_lo, int y_hi, int z_lo, int z_hi,
+    float* block
+);
+
+// Anisotropic counterparts: gaussian i contributes
+// opacity * exp(-0.5 * d^T inv_cov d) where d^T inv_cov d <= cutoff_sigmas^2,
+// taking centers and opacity from centers and inverse covariances from shape
+float evaluateAnisotropicDensity(
+    const IsotropicKernelData& centers, const GaussianAttributeTable& shape, float cutoff_sigmas,
+    float px, float py, float pz
+);
+void accumulateAnisotropicBlockDensity(
+    const IsotropicKernelData& centers, const GaussianAttributeTable& shape, size_t index, float cutoff_sigmas,
+    const float origin[3], float spacing,
+    int y_lo, int y_hi, int z_lo, int z_hi,
+    float* block
+);
+
+} // namespace AmeScanner
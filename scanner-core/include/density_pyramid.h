@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <Eigen/Core>
+
+namespace AmeScanner {
+
+// Max/sum mip pyramid over the bricks of a sparse density field. Level 0
+// cells are the bricks themselves (cell index == brick index); each level
+// above halves the resolution, so a level-l cell covers 2^l bricks per
+// axis. Only occupied cells exist. Queries walk down from the top and
+// only open cells whose max can still reach the threshold.
+class DensityPyramid {
+public:
+    struct Level {
+        std::vector<Eigen::Vector3i> coords;   // Cell coordinate at this level
+        std::vector<float> max;
+        std::vector<float> sum;
+        // Children of cell c are children[child_offsets[c] .. child_offsets[c + 1])
+        // in the level below; both are empty at level 0
+        std::vector<uint32_t> child_offsets;
+        std::vector<uint32_t> children;
+    };
+    
+    // Build from per-brick coordinates, maxima and sums
+    void build(
+        std::span<const Eigen::Vector3i> brick_coords,
+        std::span<const float> brick_max,
+        std::span<const float> brick_sum
+    );
+    void clear() { levels_.clear(); }
+    
+    bool empty() const { return levels_.empty(); }
+    size_t getNumLevels() const { return levels_.size(); }
+    const Level& getLevel(size_t level) const { return levels_[level]; }
+    
+    // Largest density and summed density of the whole field
+    float getMax() const;
+    double getSum() const;
+    
+    // Indices of the bricks whose max is >= threshold, in ascending order
+    void collectBricks(float threshold, std::vector<uint32_t>& bricks) const;
+    
+private:
+    std::vector<Level> levels_;
+};
+
+} // namespace AmeScanner
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <Eigen/Core>
+#include "gaussian.h"
+
+namespace AmeScanner {
+
+// Derived shape attributes for a set of gaussians, computed once in
+// parallel and stored as SoA so anisotropic kernels never rebuild
+// R*S*R^T or invert it per evaluation. Symmetric 3x3 matrices are packed
+// as six columns indexed by PackedIndex.
+class GaussianAttributeTable {
+public:
+    enum PackedIndex { XX = 0, XY, XZ, YY, YZ, ZZ };
+    
+    explicit GaussianAttributeTable(float extent_sigmas = 3.0f) : extent_sigmas_(extent_sigmas) {}
+    
+    // Rebuild the table for gaussians; radii and extents cover extent_sigmas
+    void build(std::span<const Gaussian> gaussians, float extent_sigmas);
+    void build(std::span<const Gaussian> gaussians) { build(gaussians, extent_sigmas_); }
+    
+    void build(std::span<const Gaussian> gaussians, std::span<const uint32_t> selection, float extent_sigmas);
+    
+    // Append attributes for more gaussians, keeping existing rows
+    void append(std::span<const Gaussian> gaussians);
+    
+    // Append rows only for gaussians[selection[i]], in selection order
+    void append(std::span<const Gaussian> gaussians, std::span<const uint32_t> selection);
+    
+    void clear();
+    size_t size() const { return bounding_radius_.size(); }
+    float getExtentSigmas() const { return extent_sigmas_; }
+    
+    // Packed covariance / inverse covariance columns
+    const std::vector<float>& getCovariance(PackedIndex component) const { return covariance_[component]; }
+    const std::vector<float>& getInverseCovariance(PackedIndex component) const { return inverse_covariance_[component]; }
+    
+    // Radius of the sphere enclosing the extent_sigmas ellipsoid
+    const std::vector<float>& getBoundingRadii() const { return bounding_radius_; }
+    float getMaxBoundingRadius() const { return max_bounding_radius_; }
+    
+    // Half-size of the axis-aligned box enclosing the extent_sigmas ellipsoid
+    const std::vector<float>& getExtentX() const { return extent_x_; }
+    const std::vector<float>& getExtentY() const { return extent_y_; }
+    const std::vector<float>& getExtentZ() const { return extent_z_; }
+    
+    // Unpacked accessors for non-hot code
+    Eigen::Matrix3f getCovarianceMatrix(size_t idx) const;
+    Eigen::Matrix3f getInverseCovarianceMatrix(size_t idx) const;
+    
+    // Squared Mahalanobis distance of offset (point - center) for gaussian idx
+    float mahalanobisDistanceSq(size_t idx, const Eigen::Vector3f& offset) const {
+        const float x = offset.x(), y = offset.y(), z = offset.z();
+        return inverse_covariance_[XX][idx] * x * x + inverse_covariance_[YY][idx] * y * y +
+               inverse_covariance_[ZZ][idx] * z * z +
+               2.0f * (inverse_covariance_[XY][idx] * x * y + inverse_covariance_[XZ][idx] * x * z +
+                       inverse_covariance_[YZ][idx] * y * z);
+    }
+    
+private:
+    float extent_sigmas_;
+    float max_bounding_radius_ = 0.0f;
+    
+    std::vector<float> covariance_[6];
+    std::vector<float> inverse_covariance_[6];
+    std::vector<float> bounding_radius_;
+    std::vector<float> extent_x_;
+    std::vector<float> extent_y_;
+    std::vector<float> extent_z_;
+    
+    // Helper methods
+    void resize(size_t rows);
+    void fillRow(size_t row, const Gaussian& gaussian);
+};
+
+} // namespace AmeScanner
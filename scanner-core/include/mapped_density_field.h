@@ -0,0 +1,122 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <Eigen/Core>
+#include "sparse_density_field.h"
+
+namespace AmeScanner {
+
+// Read-only view of a density field file through mmap. Nothing is copied on
+// open: the brick tables and values are read straight from the mapping and
+// the kernel pages them in on first touch, so a tool that only looks at a
+// few bricks only reads those pages.
+//
+// File layout, native byte order:
+//   Header                  128 bytes
+//   brick keys              uint64 per brick, ascending (SparseDensityField::packKey)
+//   brick max, brick sum    float per brick each
+//   brick values            kBrickVoxels floats per brick, x fastest, starting
+//                           on a kPageAlignment boundary so no brick straddles
+//                           a page
+class MappedDensityField {
+public:
+    static constexpr char kMagic[8] = {'A', 'M', 'E', 'D', 'E', 'N', 'S', '\0'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kPageAlignment = 4096;
+    
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t brick_size;
+        
+        // Grid: voxel (i, j, k) is centered at min_bounds + (i + 0.5, j + 0.5, k + 0.5) * grid_size
+        float min_bounds[3];
+        float grid_size;
+        int32_t dims[3];
+        float max_bounds[3];
+        
+        // Statistics of the analysis that produced the field
+        float min_density;
+        float max_density;
+        float mean_density;
+        float median_density;
+        float p90_density;
+        float p99_density;
+        float std_dev_density;
+        uint32_t reserved;
+        
+        // Section offsets in bytes from the start of the file
+        uint64_t num_bricks;
+        uint64_t keys_offset;
+        uint64_t max_offset;
+        uint64_t sum_offset;
+        uint64_t values_offset;
+    };
+    static_assert(sizeof(Header) == 128, "density field header must stay 128 bytes");
+    
+    // Write field to file_path. Geometry is taken from the field, bounds and
+    // statistics from header; the remaining header fields are filled in. The
+    // file is written next to file_path and renamed into place, so readers
+    // never map a partial file.
+    static bool write(const std::string& file_path, const Header& header, const SparseDensityField& field);
+    
+    MappedDensityField() = default;
+    ~MappedDensityField();
+    MappedDensityField(MappedDensityField&& other) noexcept;
+    MappedDensityField& operator=(MappedDensityField&& other) noexcept;
+    MappedDensityField(const MappedDensityField&) = delete;
+    MappedDensityField& operator=(const MappedDensityField&) = delete;
+    
+    // Map a file written by write(); replaces any open mapping
+    bool open(const std::string& file_path);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+    
+    const Header& getHeader() const { return *header_; }
+    Eigen::Vector3f getMinBounds() const { return Eigen::Vector3f(header_->min_bounds[0], header_->min_bounds[1], header_->min_bounds[2]); }
+    Eigen::Vector3f getMaxBounds() const { return Eigen::Vector3f(header_->max_bounds[0], header_->max_bounds[1], header_->max_bounds[2]); }
+    float getGridSize() const { return header_->grid_size; }
+    Eigen::Vector3i getDims() const { return Eigen::Vector3i(header_->dims[0], header_->dims[1], header_->dims[2]); }
+    Eigen::Vector3f getVoxelCenter(const Eigen::Vector3i& voxel) const {
+        return getMinBounds() + (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * getGridSize();
+    }
+    
+    // Bricks are ordered by packed key, not in the order they were built
+    size_t getNumBricks() const { return keys_.size(); }
+    Eigen::Vector3i getBrickCoord(size_t brick) const { return SparseDensityField::unpackKey(keys_[brick]); }
+    const float* getBrickValues(size_t brick) const { return values_.data() + brick * SparseDensityField::kBrickVoxels; }
+    float getBrickMax(size_t brick) const { return max_[brick]; }
+    float getBrickSum(size_t brick) const { return sum_[brick]; }
+    std::span<const float> getValues() const { return values_; }
+    
+    // Index of the brick at brick_coord, or SparseDensityField::kNoBrick;
+    // a binary search over the key table
+    int64_t findBrick(const Eigen::Vector3i& brick_coord) const;
+    
+    // Density at a voxel; voxels in missing bricks read as zero
+    float getValue(const Eigen::Vector3i& voxel) const;
+    
+    // Indices of the bricks whose max is >= threshold, in ascending order.
+    // Only touches the max table.
+    void collectBricks(float threshold, std::vector<uint32_t>& bricks) const;
+    
+    // Copy into an in-memory field, e.g. to run region labeling on it
+    void copyTo(SparseDensityField& field) const;
+    
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+    const Header* header_ = nullptr;
+    std::span<const uint64_t> keys_;
+    std::span<const float> max_;
+    std::span<const float> sum_;
+    std::span<const float> values_;
+    
+    // Helper methods
+    bool validate(const std::string& file_path) const;
+};
+
+} // namespace AmeScanner
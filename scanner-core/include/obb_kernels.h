@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "spatial_structure_package.h"
+
+namespace AmeScanner {
+
+// Column layout of an OBB in SoA arrays: center, then the three axes
+// (column kOBBAxes + 3 * k + r is component r of axis k), then extents
+constexpr int kOBBCenter = 0;
+constexpr int kOBBAxes = 3;
+constexpr int kOBBExtents = 12;
+constexpr int kOBBColumns = 15;
+
+// Boxes processed together in one SIMD batch
+constexpr int kOBBBatchSize = 16;
+
+// Store obb at entry i of SoA columns
+inline void packOBB(const OBB& obb, float* const columns[kOBBColumns], size_t i) {
+    for (int r = 0; r < 3; ++r) {
+        columns[kOBBCenter + r][i] = obb.center[r];
+        columns[kOBBExtents + r][i] = obb.extents[r];
+        for (int k = 0; k < 3; ++k) {
+            columns[kOBBAxes + 3 * k + r][i] = obb.rotation(r, k);
+        }
+    }
+}
+
+// Exact geometry of count box pairs (a[.][i], b[.][i]) in SoA layout:
+// - separation[i]: largest gap along the 15 separating axes; the boxes
+//   intersect exactly when it is <= 0, and when positive it is a lower
+//   bound on the distance
+// - distance[i]: distance between the boxes, 0 when they intersect, as
+//   the closest of all corner-box and edge-edge pairs
+// - a_contains_b[i] / b_contains_a[i]: 1 if every corner of one box lies
+//   inside the other
+// Output arrays may be null when not needed.
+void computeOBBPairs(
+    size_t count,
+    const float* const a[kOBBColumns],
+    const float* const b[kOBBColumns],
+    float* separation,
+    float* distance,
+    uint8_t* a_contains_b,
+    uint8_t* b_contains_a
+);
+
+} // namespace AmeScanner
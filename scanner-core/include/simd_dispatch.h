@@ -0,0 +1,12 @@
+#pragma once
+
+// Function multi-versioning for hot loops. Functions marked with
+// AME_SIMD_CLONES are compiled once per listed instruction set and the
+// best version is picked at load time from the running CPU. The loops
+// themselves are written over SoA arrays so the compiler can vectorize
+// them for each target.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+#define AME_SIMD_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define AME_SIMD_CLONES
+#endif
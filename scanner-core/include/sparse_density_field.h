@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <span>
+#include <cstdint>
+#include <Eigen/Core>
+#include "density_pyramid.h"
+
+namespace AmeScanner {
+
+// Density field stored as 8x8x8 voxel bricks in a hash map. Only bricks
+// holding a voxel above the build epsilon are kept, so memory follows the
+// occupied volume rather than the bounding box. Voxel (i, j, k) is centered
+// at origin + (i + 0.5, j + 0.5, k + 0.5) * voxel_size, with 0 <= i < dims.x.
+class SparseDensityField {
+public:
+    static constexpr int kBrickSize = 8;
+    static constexpr size_t kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+    // Brick keys pack 21 bits per axis, which bounds the voxel domain
+    static constexpr int kMaxVoxelsPerAxis = (1 << 21) * kBrickSize;
+    static constexpr int64_t kNoBrick = -1;
+    
+    SparseDensityField() = default;
+    
+    // Drop all bricks and set up an empty domain
+    void reset(const Eigen::Vector3f& origin, float voxel_size, const Eigen::Vector3i& dims);
+    
+    void reserve(size_t num_bricks);
+    
+    // Append a brick; values holds kBrickVoxels densities, x fastest.
+    // Returns the brick index. Adding the same brick twice is an error.
+    size_t addBrick(const Eigen::Vector3i& brick_coord, const float* values);
+    
+    const Eigen::Vector3f& getOrigin() const { return origin_; }
+    float getVoxelSize() const { return voxel_size_; }
+    const Eigen::Vector3i& getDims() const { return dims_; }
+    Eigen::Vector3f getVoxelCenter(const Eigen::Vector3i& voxel) const {
+        return origin_ + (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * voxel_size_;
+    }
+    
+    size_t getNumBricks() const { return brick_coords_.size(); }
+    const Eigen::Vector3i& getBrickCoord(size_t brick) const { return brick_coords_[brick]; }
+    const float* getBrickValues(size_t brick) const { return values_.data() + brick * kBrickVoxels; }
+    float getBrickMax(size_t brick) const { return brick_max_[brick]; }
+    float getBrickSum(size_t brick) const { return brick_sum_[brick]; }
+    
+    // All stored voxels, brick after brick
+    std::span<const float> getValues() const { return values_; }
+    
+    // Index of the brick at brick_coord, or kNoBrick
+    int64_t findBrick(const Eigen::Vector3i& brick_coord) const;
+    
+    // Density at a voxel; voxels in missing bricks read as zero
+    float getValue(const Eigen::Vector3i& voxel) const;
+    
+    // Build the max/sum pyramid over the current bricks. Adding a brick
+    // afterwards drops the pyramid.
+    void buildPyramid();
+    const DensityPyramid& getPyramid() const { return pyramid_; }
+    
+    // Indices of the bricks whose max is >= threshold, in ascending order;
+    // uses the pyramid when it is built
+    void collectBricks(float threshold, std::vector<uint32_t>& bricks) const;
+    
+    // Bytes held by brick storage and the lookup table
+    size_t getMemoryUsage() const;
+    
+    // 21 bits per axis, x highest; ordering by key orders bricks by x, y, z
+    static uint64_t packKey(const Eigen::Vector3i& brick_coord);
+    static Eigen::Vector3i unpackKey(uint64_t key);
+    
+private:
+    Eigen::Vector3f origin_ = Eigen::Vector3f::Zero();
+    float voxel_size_ = 0.1f;
+    Eigen::Vector3i dims_ = Eigen::Vector3i::Zero();
+    
+    std::vector<Eigen::Vector3i> brick_coords_;
+    std::vector<float> values_;       // kBrickVoxels per brick
+    std::vector<float> brick_max_;
+    std::vector<float> brick_sum_;
+    std::unordered_map<uint64_t, uint32_t> lookup_;  // Packed brick coord -> brick index
+    DensityPyramid pyramid_;
+};
+
+} // namespace AmeScanner
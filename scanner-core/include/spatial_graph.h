@@ -2,8 +2,13 @@
 
 #include <vector>
 #include <string>
+#include <span>
+#include <iterator>
+#include <cstdint>
 #include <Eigen/Core>
 #include "spatial_structure_package.h"
+#include "bounding_volume_hierarchy.h"
+#include "obb_kernels.h"
 
 namespace AmeScanner {
 
@@ -11,50 +16,180 @@ class SpatialGraph {
 public:
     SpatialGraph() = default;
     
-    // Build spatial relationship graph from entities
+    // Directional relations (above, left_of, ...) are kept only between
+    // entities whose centers are within the cutoff, and for each source
+    // only toward its nearest max_neighbors such partners
+    void setDirectionalCutoff(float distance) { directional_cutoff_ = distance; }
+    void setMaxDirectionalNeighbors(size_t max_neighbors) { max_directional_neighbors_ = max_neighbors; }
+    
+    // Build spatial relationship graph from entities. A BVH over the
+    // entities' bounding boxes supplies the candidate pairs: those whose
+    // boxes overlap or come within the adjacency or directional distance.
+    // Relationships are stored as CSR adjacency: the row of a source is
+    // its index in entities, and targets are entity indices in ascending
+    // order. Sources are evaluated in parallel; the result does not depend
+    // on the number of threads.
     void buildGraph(const std::vector<AmeEntity>& entities);
     
-    // Get spatial relationships
-    const std::vector<SpatialRelationship>& getRelationships() const {
-        return relationships_;
+    // Refresh the graph after the entities at the given indices changed;
+    // entities is the full list, in the order it was built from. Only
+    // rows that can hold an edge to a changed entity are recomputed:
+    // those of the changed entities and of their old and new broad-phase
+    // partners, found through the refit BVH. The result matches a full
+    // buildGraph. Returns false if the list does not match the graph.
+    bool updateEntities(const std::vector<AmeEntity>& entities, const std::vector<uint32_t>& changed);
+    
+    size_t getNumEntities() const { return entity_ids_.size(); }
+    size_t getNumRelationships() const { return targets_.size(); }
+    
+    // Targets and relationship types of a source's row
+    std::span<const uint32_t> getNeighbors(uint32_t source) const {
+        return {targets_.data() + row_offsets_[source], targets_.data() + row_offsets_[source + 1]};
+    }
+    
+    std::span<const RelationshipType> getNeighborTypes(uint32_t source) const {
+        return {types_.data() + row_offsets_[source], types_.data() + row_offsets_[source + 1]};
+    }
+    
+    // Bit t is set when the source has a relationship of type t
+    uint16_t getTypeMask(uint32_t source) const { return type_masks_[source]; }
+    
+    bool hasRelationship(uint32_t source, RelationshipType type) const {
+        return (type_masks_[source] >> static_cast<int>(type)) & 1;
     }
     
-    // Get relationship types
+    // Call fn(target) for the source's targets of the given type
+    template <typename Fn>
+    void forEachNeighbor(uint32_t source, RelationshipType type, Fn&& fn) const;
+    
+    // Id of the entity at an index
+    uint32_t getEntityId(uint32_t index) const { return entity_ids_[index]; }
+    
+    // Expanded list with entity ids, ordered by source, then target
+    std::vector<SpatialRelationship> getRelationships() const;
+    
+    // Display names, indexed by RelationshipType
+    static constexpr const char* kRelationshipNames[] = {
+        "contains",
+        "contained_by",
+        "above",
+        "below",
+        "left_of",
+        "right_of",
+        "front_of",
+        "behind",
+        "adjacent_to"
+    };
+    static_assert(std::size(kRelationshipNames) == static_cast<size_t>(RelationshipType::None),
+                  "kRelationshipNames must name every RelationshipType");
+    
+    // Get relationship types, for display; indexed by RelationshipType
     static std::vector<std::string> getRelationshipTypes() {
-        return {
-            "contains",
-            "contained_by",
-            "above",
-            "below",
-            "left_of",
-            "right_of",
-            "front_of",
-            "behind",
-            "adjacent_to"
-        };
+        return std::vector<std::string>(std::begin(kRelationshipNames), std::end(kRelationshipNames));
     }
     
+    static const char* getRelationshipName(RelationshipType type);
+    static float getConfidence(RelationshipType type);
+    
     // Compute relationship between two entities
     SpatialRelationship computeRelationship(const AmeEntity& entity1, const AmeEntity& entity2);
     
     // Visualize the graph (optional)
     bool visualize(const std::string& output_file) const;
     
+    // Get graph building statistics
+    struct Statistics {
+        size_t num_candidate_pairs = 0;  // Ordered pairs from the broad phase
+        size_t num_relationships = 0;
+        size_t graph_bytes = 0;          // CSR arrays and type masks
+        float build_time_ms = 0.0f;
+        size_t num_updated_rows = 0;     // Rows recomputed by the last updateEntities
+        float update_time_ms = 0.0f;
+    };
+    
+    const Statistics& getStatistics() const { return stats_; }
+    
+    // Axis-aligned bounds of an OBB
+    static Eigen::AlignedBox3f computeBounds(const OBB& obb);
+    
+    // Exact OBB tests, one pair at a time through the batched kernels
+    static float computeDistance(const OBB& obb1, const OBB& obb2);
+    static bool intersects(const OBB& obb1, const OBB& obb2);
+    static bool contains(const OBB& container, const OBB& contained);
+    
 private:
-    std::vector<SpatialRelationship> relationships_;
+    // Geometry of an ordered pair from computeOBBPairs
+    struct PairGeometry {
+        bool contains = false;      // First box contains the second
+        bool contained_by = false;  // Second box contains the first
+        float separation = 0.0f;    // Largest separating-axis gap, <= 0 when intersecting
+        float distance = 0.0f;
+    };
+    
+    // Adjacent entities are closer than this
+    static constexpr float kAdjacencyDistance = 0.1f;
+    
+    float directional_cutoff_ = 2.0f;
+    size_t max_directional_neighbors_ = 8;
+    
+    BoundingVolumeHierarchy bvh_;
+    Statistics stats_;
+    
+    // CSR adjacency: row r spans [row_offsets_[r], row_offsets_[r + 1])
+    std::vector<uint32_t> entity_ids_;
+    std::vector<uint32_t> row_offsets_;
+    std::vector<uint32_t> targets_;
+    std::vector<RelationshipType> types_;
+    std::vector<uint16_t> type_masks_;
+    
+    // Sources per parallel task; each task fills its own edge buffer
+    static constexpr size_t kSourcesPerTask = 64;
+    
+    // Per-worker buffers for evaluating one source's candidate pairs
+    struct RowScratch {
+        std::vector<uint32_t> candidates;
+        std::vector<float> columns[2][kOBBColumns];  // SoA boxes for the kernels
+        std::vector<float> near_columns[2][kOBBColumns];
+        std::vector<uint32_t> near;
+        std::vector<float> separations;
+        std::vector<float> distances;
+        std::vector<uint8_t> contains;
+        std::vector<uint8_t> contained;
+        std::vector<std::pair<float, size_t>> directional;
+        std::vector<std::pair<uint32_t, RelationshipType>> row;
+    };
+    
+    // Rows of consecutive sources, before they are merged into the CSR
+    struct EdgeBuffer {
+        std::vector<uint32_t> targets;
+        std::vector<RelationshipType> types;
+    };
+    
+    std::vector<RowScratch> scratch_;
     
     // Helper methods
-    bool contains(const AmeEntity& container, const AmeEntity& contained);
+    size_t evaluateRow(const std::vector<AmeEntity>& entities, uint32_t source, RowScratch& scratch, EdgeBuffer& edges);
+    void measurePairs(size_t count, RowScratch& scratch, float* distances, uint8_t* contains, uint8_t* contained);
+    void keepNearestDirectional(const std::vector<AmeEntity>& entities, uint32_t source, size_t first, RowScratch& scratch, EdgeBuffer& edges);
+    void computeGraphBytes();
+    static PairGeometry computePairGeometry(const OBB& obb1, const OBB& obb2);
+    RelationshipType classifyRelationship(const AmeEntity& entity1, const AmeEntity& entity2, const PairGeometry& geometry);
     bool isAbove(const AmeEntity& entity1, const AmeEntity& entity2);
     bool isLeftOf(const AmeEntity& entity1, const AmeEntity& entity2);
     bool isFrontOf(const AmeEntity& entity1, const AmeEntity& entity2);
-    bool isAdjacent(const AmeEntity& entity1, const AmeEntity& entity2);
-    
-    // Compute distance between two OBBs
-    float computeDistance(const OBB& obb1, const OBB& obb2);
-    
-    // Check if two OBBs intersect
-    bool intersects(const OBB& obb1, const OBB& obb2);
+    static bool isDirectional(RelationshipType type);
 };
 
+template <typename Fn>
+void SpatialGraph::forEachNeighbor(uint32_t source, RelationshipType type, Fn&& fn) const {
+    if (!hasRelationship(source, type)) {
+        return;
+    }
+    for (uint32_t e = row_offsets_[source]; e < row_offsets_[source + 1]; ++e) {
+        if (types_[e] == type) {
+            fn(targets_[e]);
+        }
+    }
+}
+
 } // namespace AmeScanner
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <Eigen/Core>
+
+namespace AmeScanner {
+
+// Uniform hash grid over point positions. Points can be appended at any
+// time without rebuilding, so the same index serves batch and incremental use.
+class SpatialHashGrid {
+public:
+    explicit SpatialHashGrid(float cell_size = 0.1f) { reset(cell_size); }
+    
+    // Drop all points and change the cell size
+    void reset(float cell_size);
+    
+    // Append a point; returns its index
+    uint32_t insert(const Eigen::Vector3f& position);
+    
+    size_t size() const { return positions_.size(); }
+    float getCellSize() const { return cell_size_; }
+    const Eigen::Vector3f& getPosition(uint32_t idx) const { return positions_[idx]; }
+    
+    // Call fn(idx) for every point within radius of center (inclusive)
+    template <typename Fn>
+    void forEachInRadius(const Eigen::Vector3f& center, float radius, Fn&& fn) const;
+    
+    // Collect indices of points within radius of center into out (cleared first)
+    void radiusQuery(const Eigen::Vector3f& center, float radius, std::vector<uint32_t>& out) const;
+    
+private:
+    float cell_size_;
+    float inv_cell_size_;
+    std::vector<Eigen::Vector3f> positions_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> cells_;
+    
+    // Helper methods
+    int cellCoord(float value) const { return static_cast<int>(std::floor(value * inv_cell_size_)); }
+    static uint64_t packKey(int x, int y, int z);
+};
+
+template <typename Fn>
+void SpatialHashGrid::forEachInRadius(const Eigen::Vector3f& center, float radius, Fn&& fn) const {
+    const float radius_sq = radius * radius;
+    const int x0 = cellCoord(center.x() - radius), x1 = cellCoord(center.x() + radius);
+    const int y0 = cellCoord(center.y() - radius), y1 = cellCoord(center.y() + radius);
+    const int z0 = cellCoord(center.z() - radius), z1 = cellCoord(center.z() + radius);
+    
+    for (int z = z0; z <= z1; ++z) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                auto it = cells_.find(packKey(x, y, z));
+                if (it == cells_.end()) {
+                    continue;
+                }
+                for (uint32_t idx : it->second) {
+                    if ((positions_[idx] - center).squaredNorm() <= radius_sq) {
+                        fn(idx);
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace AmeScanner
@@ -2,14 +2,15 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <Eigen/Core>
 
 namespace AmeScanner {
 
 struct OBB {
     Eigen::Vector3f center;
-    Eigen::Matrix3f rotation;
-    Eigen::Vector3f extents;
+    Eigen::Matrix3f rotation;   // Columns are the box axes
+    Eigen::Vector3f extents;    // Half sizes along the axes
 };
 
 struct AmeEntity {
@@ -20,10 +21,27 @@ struct AmeEntity {
     uint32_t physics_handle;
 };
 
+// Relation of a source entity to a target, in the order of the display
+// names from SpatialGraph::getRelationshipTypes()
+enum class RelationshipType : uint8_t {
+    Contains,
+    ContainedBy,
+    Above,
+    Below,
+    LeftOf,
+    RightOf,
+    FrontOf,
+    Behind,
+    AdjacentTo,
+    None  // No relation; never stored in a graph
+};
+
+constexpr int kNumRelationshipTypes = static_cast<int>(RelationshipType::None);
+
 struct SpatialRelationship {
     uint32_t source_id;
     uint32_t target_id;
-    std::string relationship_type;
+    RelationshipType relationship_type;
     float confidence;
 };
 
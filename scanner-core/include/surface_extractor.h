@@ -3,21 +3,44 @@
 #include <vector>
 #include <Eigen/Core>
 #include "gaussian.h"
+#include "spatial_hash_grid.h"
 
 namespace AmeScanner {
 
 class SurfaceExtractor {
 public:
+    // Where normals, curvature and eigenvalues come from
+    enum class NormalMode {
+        Neighborhood,  // PCA of neighbor positions for every gaussian
+        SplatShape     // The splat's own covariance; neighborhood PCA only for near-isotropic splats
+    };
+    
     SurfaceExtractor(float normal_threshold = 0.3f, float curvature_threshold = 0.5f) 
         : normal_threshold_(normal_threshold), curvature_threshold_(curvature_threshold) {}
     
     // Set parameters
     void setNormalThreshold(float threshold) { normal_threshold_ = threshold; }
     void setCurvatureThreshold(float threshold) { curvature_threshold_ = threshold; }
+    void setNormalMode(NormalMode mode) { normal_mode_ = mode; }
+    // Splats with flatness below this are too round to orient and fall back
+    // to neighborhood PCA in SplatShape mode
+    void setMinFlatness(float flatness) { min_flatness_ = flatness; }
+    // Candidates closer than the grouping radius join the same region;
+    // regions smaller than the minimum size are dropped
+    void setGroupingRadius(float radius) { grouping_radius_ = radius; }
+    void setMinRegionSize(size_t size) { min_region_size_ = size; }
     
     // Extract surface candidates from gaussians
     std::vector<std::vector<size_t>> extractSurfaceCandidates(const std::vector<Gaussian>& gaussians);
     
+    // Curvature at several neighborhood radii in one pass. Per-voxel
+    // moments (count, sum, sum of outer products) are box-summed over a cube
+    // of half-width about the radius around each voxel, which gives every
+    // gaussian a covariance per radius in O(1). Cubes include the gaussian
+    // itself. A voxel size <= 0 means half the smallest radius. Returns
+    // false if the moment grid would be too large.
+    bool computeMultiScaleCurvatures(const std::vector<Gaussian>& gaussians, const std::vector<float>& radii, float voxel_size = 0.0f);
+    
     // Compute normal for a gaussian
     Eigen::Vector3f computeNormal(const std::vector<Gaussian>& gaussians, size_t gaussian_idx);
     
@@ -30,17 +53,58 @@ public:
     // Get curvatures for all gaussians
     const std::vector<float>& getCurvatures() const { return curvatures_; }
     
+    // Get neighborhood covariance eigenvalues for all gaussians, ascending;
+    // zero where a gaussian has fewer than three neighbors
+    const std::vector<Eigen::Vector3f>& getEigenvalues() const { return eigenvalues_; }
+    
+    // Get splat flatness for all gaussians: 1 - smallest / middle scale,
+    // 0 for a sphere or needle and 1 for a flat disk
+    const std::vector<float>& getFlatness() const { return flatness_; }
+    
+    // Get curvatures of the last multi-scale pass, [radius][gaussian]
+    const std::vector<std::vector<float>>& getMultiScaleCurvatures() const { return multi_scale_curvatures_; }
+    
+    // Number of gaussians that fell back to neighborhood PCA in the last
+    // extraction; all of them in Neighborhood mode
+    size_t getNumNeighborhoodFallbacks() const { return num_fallbacks_; }
+    
 private:
+    // Neighborhood used for normals and curvature
+    static constexpr float kNeighborhoodRadius = 0.1f;
+    
+    // Largest dense moment grid of the multi-scale pass (one double channel)
+    static constexpr size_t kMaxMomentVoxels = size_t(1) << 27;
+    
+    // Normal, curvature and covariance eigenvalues of one neighborhood
+    struct LocalShape {
+        Eigen::Vector3f normal = Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+        float curvature = 1.0f;
+        Eigen::Vector3f eigenvalues = Eigen::Vector3f::Zero();
+    };
+    
     float normal_threshold_;
     float curvature_threshold_;
+    NormalMode normal_mode_ = NormalMode::Neighborhood;
+    float min_flatness_ = 0.3f;
+    float grouping_radius_ = 0.2f;
+    size_t min_region_size_ = 5;
     
+    SpatialHashGrid index_;
     std::vector<Eigen::Vector3f> normals_;
     std::vector<float> curvatures_;
+    std::vector<Eigen::Vector3f> eigenvalues_;
+    std::vector<float> flatness_;
+    std::vector<std::vector<float>> multi_scale_curvatures_;
+    size_t num_fallbacks_ = 0;
     
     // Helper methods
     std::vector<size_t> findNeighbors(const std::vector<Gaussian>& gaussians, size_t gaussian_idx, float radius);
-    Eigen::Vector3f estimateNormalFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors);
-    float estimateCurvatureFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors);
+    bool useSplatShape(const Gaussian& gaussian) const;
+    void estimateNeighborhoodShapes(const std::vector<size_t>& indices);
+    LocalShape estimateShapeFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors);
+    static float splatFlatness(const Eigen::Vector3f& scale);
+    static LocalShape shapeFromSplat(const Gaussian& gaussian);
+    static LocalShape shapeFromEigen(const Eigen::Vector3f& eigenvalues, const Eigen::Vector3f& smallest_eigenvector);
 };
 
 } // namespace AmeScanner
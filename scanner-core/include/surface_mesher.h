@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <Eigen/Core>
+#include "sparse_density_field.h"
+
+namespace AmeScanner {
+
+// Indexed triangle mesh; triangles wind counter-clockwise seen from outside
+struct TriangleMesh {
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<uint32_t> indices;  // Three per triangle
+    
+    size_t getNumTriangles() const { return indices.size() / 3; }
+    bool empty() const { return indices.empty(); }
+};
+
+// Isosurface extraction with surface nets: one vertex per voxel cell that
+// the iso level crosses, placed at the mean of the edge crossings, and one
+// quad per crossed voxel edge. Cells are processed in brick-sized blocks;
+// only blocks touching a region's bricks are visited.
+class SurfaceMesher {
+public:
+    SurfaceMesher() = default;
+    
+    // Mesh each region of a labeling produced by
+    // DensityAnalyzer::labelDenseRegions(field, iso_level, &voxel_labels).
+    // Mesh r encloses exactly the voxels labeled r; voxels of other regions
+    // are treated as empty, so touching regions get separate closed meshes.
+    std::vector<TriangleMesh> meshRegions(
+        const SparseDensityField& field,
+        const std::vector<int32_t>& voxel_labels,
+        size_t num_regions,
+        float iso_level
+    );
+    
+    // Binary .amesh file: header, float32 positions, then uint16 indices
+    // when every vertex fits and uint32 indices otherwise
+    static bool saveMesh(const std::string& file_path, const TriangleMesh& mesh);
+    static bool loadMesh(const std::string& file_path, TriangleMesh& mesh);
+    
+    // Get meshing statistics
+    struct Statistics {
+        size_t num_blocks = 0;     // Blocks visited over all regions
+        size_t num_vertices = 0;
+        size_t num_triangles = 0;
+        float meshing_time_ms = 0.0f;
+    };
+    
+    const Statistics& getStatistics() const { return stats_; }
+    
+private:
+    Statistics stats_;
+};
+
+} // namespace AmeScanner
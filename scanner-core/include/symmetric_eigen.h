@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace AmeScanner {
+
+// Matrices decomposed together in one SIMD batch
+constexpr int kEigenBatchSize = 16;
+
+// Eigen decomposition of count symmetric 3x3 matrices with cyclic Jacobi
+// rotations, kEigenBatchSize matrices per batch. Input is SoA: packed[c][i]
+// is component c of matrix i, in GaussianAttributeTable::PackedIndex order
+// (XX, XY, XZ, YY, YZ, ZZ). eigenvalues[k][i] receives the k-th eigenvalue
+// of matrix i in ascending order and eigenvectors[3 * k + axis][i] the
+// matching unit eigenvector. Input and output arrays may not alias.
+void solveSymmetricEigen3(
+    size_t count,
+    const float* const packed[6],
+    float* const eigenvalues[3],
+    float* const eigenvectors[9]
+);
+
+// One matrix, same layouts with a single entry per array
+void solveSymmetricEigen3(const float packed[6], float eigenvalues[3], float eigenvectors[9]);
+
+} // namespace AmeScanner
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace AmeScanner {
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in every loop as worker 0, so per-thread buffers can be sized
+// with getNumThreads() and indexed by the worker id passed to the body.
+class ThreadPool {
+public:
+    // num_threads == 0 uses the hardware concurrency
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    // Process-wide pool shared by scanner-core. Sized by the last
+    // setGlobalThreadCount(), else by the AME_NUM_THREADS environment
+    // variable, else by the hardware concurrency.
+    static ThreadPool& global();
+    
+    // Recreate the global pool with num_threads workers; 0 restores the
+    // default size. Must not be called while a loop runs on the pool.
+    static void setGlobalThreadCount(size_t num_threads);
+    
+    // Number of workers, including the calling thread
+    size_t getNumThreads() const { return workers_.size() + 1; }
+    
+    // Run body(begin, end, worker_id) over [0, count) in chunks of at most
+    // grain items and wait for completion. Calls made from inside a running
+    // body execute inline on the current thread.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& body);
+    
+private:
+    std::vector<std::thread> workers_;
+    std::mutex job_mutex_;            // Serializes parallelFor calls from different threads
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    bool stop_ = false;
+    uint64_t generation_ = 0;
+    size_t active_ = 0;
+    
+    // Current job
+    const std::function<void(size_t, size_t, size_t)>* body_ = nullptr;
+    size_t count_ = 0;
+    size_t grain_ = 1;
+    std::atomic<size_t> next_{0};
+    
+    // Helper methods
+    void workerLoop(size_t worker_id);
+    void runChunks(size_t worker_id);
+};
+
+} // namespace AmeScanner
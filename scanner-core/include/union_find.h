@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+namespace AmeScanner {
+
+// Disjoint sets over [0, size) that several threads may unite at once.
+// Roots are always linked under the smaller index, so after all unions
+// the root of every set is its smallest element, independent of the
+// order in which threads ran.
+class ConcurrentUnionFind {
+public:
+    explicit ConcurrentUnionFind(size_t size = 0) { reset(size); }
+    
+    // Make every element its own set
+    void reset(size_t size) {
+        parent_ = std::make_unique<std::atomic<uint32_t>[]>(size);
+        size_ = size;
+        for (size_t i = 0; i < size; ++i) {
+            parent_[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+        }
+    }
+    
+    size_t size() const { return size_; }
+    
+    // Root of the set holding x, halving the path on the way
+    uint32_t find(uint32_t x) {
+        while (true) {
+            uint32_t parent = parent_[x].load(std::memory_order_acquire);
+            if (parent == x) {
+                return x;
+            }
+            uint32_t grandparent = parent_[parent].load(std::memory_order_acquire);
+            if (grandparent != parent) {
+                parent_[x].compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+            }
+            x = grandparent;
+        }
+    }
+    
+    void unite(uint32_t a, uint32_t b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) {
+                return;
+            }
+            if (a < b) {
+                std::swap(a, b);
+            }
+            // Link the larger root under the smaller one; retry if another
+            // thread linked it first
+            uint32_t expected = a;
+            if (parent_[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel)) {
+                return;
+            }
+        }
+    }
+    
+    bool sameSet(uint32_t a, uint32_t b) { return find(a) == find(b); }
+    
+private:
+    std::unique_ptr<std::atomic<uint32_t>[]> parent_;
+    size_t size_ = 0;
+};
+
+} // namespace AmeScanner
@@ -0,0 +1,78 @@
+#include "bounding_volume_hierarchy.h"
+#include <algorithm>
+#include <numeric>
+
+namespace AmeScanner {
+
+void BoundingVolumeHierarchy::build(const std::vector<Eigen::AlignedBox3f>& boxes) {
+    boxes_ = boxes;
+    nodes_.clear();
+    items_.resize(boxes.size());
+    std::iota(items_.begin(), items_.end(), 0u);
+    if (boxes.empty()) {
+        return;
+    }
+    
+    std::vector<Eigen::Vector3f> centers(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        centers[i] = boxes[i].center();
+    }
+    nodes_.reserve(2 * boxes.size() / kLeafSize + 1);
+    buildNode(0, static_cast<uint32_t>(boxes.size()), centers);
+}
+
+void BoundingVolumeHierarchy::refit(const std::vector<uint32_t>& items, const std::vector<Eigen::AlignedBox3f>& boxes) {
+    for (size_t k = 0; k < items.size(); ++k) {
+        boxes_[items[k]] = boxes[k];
+    }
+    
+    // Children follow their parent in pre-order, so a reverse sweep sees
+    // them first
+    for (size_t index = nodes_.size(); index-- > 0;) {
+        Node& node = nodes_[index];
+        if (node.count > 0) {
+            node.box.setEmpty();
+            for (uint32_t slot = node.first; slot < node.first + node.count; ++slot) {
+                node.box.extend(boxes_[items_[slot]]);
+            }
+        } else {
+            node.box = nodes_[index + 1].box.merged(nodes_[node.first].box);
+        }
+    }
+}
+
+uint32_t BoundingVolumeHierarchy::buildNode(uint32_t begin, uint32_t end, const std::vector<Eigen::Vector3f>& centers) {
+    const uint32_t index = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    
+    Eigen::AlignedBox3f box;
+    Eigen::AlignedBox3f center_box;
+    for (uint32_t slot = begin; slot < end; ++slot) {
+        box.extend(boxes_[items_[slot]]);
+        center_box.extend(centers[items_[slot]]);
+    }
+    nodes_[index].box = box;
+    
+    if (end - begin <= kLeafSize) {
+        nodes_[index].first = begin;
+        nodes_[index].count = end - begin;
+        return index;
+    }
+    
+    // Median split along the longest axis of the centers; ties broken by
+    // item id so the tree does not depend on the input order of equal keys
+    int axis;
+    center_box.sizes().maxCoeff(&axis);
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(items_.begin() + begin, items_.begin() + mid, items_.begin() + end, [&](uint32_t a, uint32_t b) {
+        return centers[a][axis] < centers[b][axis] || (centers[a][axis] == centers[b][axis] && a < b);
+    });
+    
+    buildNode(begin, mid, centers);
+    const uint32_t right = buildNode(mid, end, centers);
+    nodes_[index].first = right;
+    nodes_[index].count = 0;
+    return index;
+}
+
+} // namespace AmeScanner
@@ -1,51 +1,106 @@
 #include "dbscan.h"
+#include "simd_dispatch.h"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 
 namespace AmeScanner {
 
+namespace {
+
+constexpr uint32_t kNoRow = ~uint32_t(0);
+
+// Returns true if the bit was already set
+inline bool testAndSetBit(std::vector<uint64_t>& bits, size_t idx) {
+    uint64_t mask = uint64_t(1) << (idx & 63);
+    uint64_t& word = bits[idx >> 6];
+    bool was_set = (word & mask) != 0;
+    word |= mask;
+    return was_set;
+}
+
+// Accept candidate i if min(d^T A d, d^T B_i d) <= threshold_sq, where A is
+// the query point's inverse covariance and B_i the candidate's (both packed)
+AME_SIMD_CLONES
+void anisotropicAccept(
+    size_t count,
+    const float* dx, const float* dy, const float* dz,
+    const float* a,
+    const float* b0, const float* b1, const float* b2,
+    const float* b3, const float* b4, const float* b5,
+    float threshold_sq,
+    uint8_t* accepted
+) {
+    for (size_t i = 0; i < count; ++i) {
+        float xx = dx[i] * dx[i], yy = dy[i] * dy[i], zz = dz[i] * dz[i];
+        float xy = 2.0f * dx[i] * dy[i], xz = 2.0f * dx[i] * dz[i], yz = 2.0f * dy[i] * dz[i];
+        float qa = a[0] * xx + a[1] * xy + a[2] * xz + a[3] * yy + a[4] * yz + a[5] * zz;
+        float qb = b0[i] * xx + b1[i] * xy + b2[i] * xz + b3[i] * yy + b4[i] * yz + b5[i] * zz;
+        accepted[i] = std::min(qa, qb) <= threshold_sq ? 1 : 0;
+    }
+}
+
+} // namespace
+
 std::vector<std::vector<size_t>> DBSCAN::cluster(const std::vector<Gaussian>& gaussians) {
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    size_t n = gaussians.size();
-    labels_.resize(n, -1); // -1 means unvisited
+    index_.reset(eps_);
+    point_ids_.clear();
+    rows_.clear();
+    opacities_.clear();
+    neighbor_weights_.clear();
+    labels_.clear();
     num_clusters_ = 0;
     num_noise_ = 0;
+    num_filtered_ = 0;
+    
+    active_mode_ = distance_mode_;
+    shape_ = GaussianAttributeTable(mahalanobis_threshold_);
+    radius_cap_ = max_splat_radius_ > 0.0f ? max_splat_radius_ : 4.0f * eps_;
+    max_bounding_radius_ = 0.0f;
+    
+    addPoints(gaussians);
+    size_t n = gaussians.size();
+    
+    // Every point enters a frontier at most once, so the frontier never
+    // holds more than n entries regardless of how dense the clusters are
+    Scratch& scratch = threadScratch();
+    scratch.queued.assign((n + 63) / 64, 0);
+    scratch.frontier.clear();
     
     for (size_t i = 0; i < n; ++i) {
-        if (labels_[i] != -1) {
-            continue; // Already visited
+        if (labels_[i] != kUnvisited) {
+            continue; // Already visited or filtered
         }
         
-        std::vector<size_t> neighbors = regionQuery(gaussians, i);
+        regionQuery(static_cast<uint32_t>(i), scratch.neighbors);
+        neighbor_weights_[i] = sumNeighborWeights(scratch.neighbors);
         
-        if (neighbors.size() < static_cast<size_t>(min_pts_)) {
-            labels_[i] = -2; // Mark as noise
+        if (!isCore(static_cast<uint32_t>(i))) {
+            labels_[i] = kNoise;
             num_noise_++;
             continue;
         }
         
-        // Expand cluster
+        // Seed the frontier with the core point's neighbors
         labels_[i] = num_clusters_;
-        
-        // Remove self from neighbors
-        for (auto it = neighbors.begin(); it != neighbors.end(); ) {
-            if (*it == i) {
-                it = neighbors.erase(it);
-            } else {
-                ++it;
+        testAndSetBit(scratch.queued, i);
+        for (uint32_t neighbor_idx : scratch.neighbors) {
+            if (!testAndSetBit(scratch.queued, neighbor_idx)) {
+                scratch.frontier.push_back(neighbor_idx);
             }
         }
         
-        expandCluster(gaussians, i, neighbors, num_clusters_);
+        expandCluster(scratch, num_clusters_);
         num_clusters_++;
     }
     
     // Generate cluster indices
-    std::vector<std::vector<size_t>> clusters(num_clusters_);
+    clusters_.assign(num_clusters_, {});
     for (size_t i = 0; i < n; ++i) {
         if (labels_[i] >= 0) {
-            clusters[labels_[i]].push_back(i);
+            clusters_[labels_[i]].push_back(i);
         }
     }
     
@@ -55,60 +110,292 @@ std::vector<std::vector<size_t>> DBSCAN::cluster(const std::vector<Gaussian>& ga
     std::cout << "DBSCAN clustering completed in " << duration_ms << " ms" << std::endl;
     std::cout << "Found " << num_clusters_ << " clusters" << std::endl;
     std::cout << "Found " << num_noise_ << " noise points" << std::endl;
+    if (num_filtered_ > 0) {
+        std::cout << "Filtered " << num_filtered_ << " points below opacity " << opacity_floor_ << std::endl;
+    }
     
-    return clusters;
+    return clusters_;
 }
 
-std::vector<size_t> DBSCAN::regionQuery(const std::vector<Gaussian>& gaussians, size_t point_idx) {
-    std::vector<size_t> neighbors;
-    const Gaussian& point = gaussians[point_idx];
+void DBSCAN::insert(std::span<const Gaussian> gaussians) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    if (labels_.empty()) {
+        index_.reset(eps_);
+        active_mode_ = distance_mode_;
+        shape_ = GaussianAttributeTable(mahalanobis_threshold_);
+        radius_cap_ = max_splat_radius_ > 0.0f ? max_splat_radius_ : 4.0f * eps_;
+    }
     
-    for (size_t i = 0; i < gaussians.size(); ++i) {
-        if (i == point_idx) {
+    const uint32_t first_new = static_cast<uint32_t>(labels_.size());
+    addPoints(gaussians);
+    const uint32_t n = static_cast<uint32_t>(labels_.size());
+    
+    // Update neighbor weights. Insertions can only promote points to core,
+    // never demote them, so the seeds are the new core points plus the old
+    // points that crossed the core threshold with this batch.
+    Scratch& scratch = threadScratch();
+    std::vector<uint32_t>& seeds = scratch.frontier;
+    seeds.clear();
+    for (uint32_t p = first_new; p < n; ++p) {
+        if (labels_[p] == kFiltered) {
             continue;
         }
+        regionQuery(p, scratch.neighbors);
+        neighbor_weights_[p] = sumNeighborWeights(scratch.neighbors);
+        for (uint32_t q : scratch.neighbors) {
+            if (q >= first_new) {
+                continue;
+            }
+            bool was_core = isCore(q);
+            neighbor_weights_[q] += neighborWeight(p);
+            if (!was_core && isCore(q)) {
+                seeds.push_back(q);
+            }
+        }
+    }
+    for (uint32_t p = first_new; p < n; ++p) {
+        if (labels_[p] != kFiltered && isCore(p)) {
+            seeds.push_back(p);
+        }
+    }
+    
+    // Connect each seed to its core neighbors and claim unassigned borders
+    for (uint32_t c : seeds) {
+        regionQuery(c, scratch.neighbors);
+        
+        int32_t cluster_id = labels_[c];
+        if (cluster_id < 0) {
+            for (uint32_t q : scratch.neighbors) {
+                if (isCore(q) && labels_[q] >= 0) {
+                    cluster_id = labels_[q];
+                    break;
+                }
+            }
+        }
+        if (cluster_id < 0) {
+            cluster_id = static_cast<int32_t>(clusters_.size());
+            clusters_.emplace_back();
+            num_clusters_++;
+        }
+        if (labels_[c] != cluster_id) {
+            assignPoint(c, cluster_id);
+        }
         
-        float dist = computeDistance(point, gaussians[i]);
-        if (dist <= eps_) {
-            neighbors.push_back(i);
+        for (uint32_t q : scratch.neighbors) {
+            int32_t label = labels_[q];
+            if (label < 0) {
+                assignPoint(q, cluster_id);
+            } else if (label != cluster_id && isCore(q)) {
+                cluster_id = mergeClusters(cluster_id, label);
+            }
         }
     }
     
-    return neighbors;
+    // New non-core points attach to any core neighbor, otherwise they are noise
+    for (uint32_t p = first_new; p < n; ++p) {
+        if (labels_[p] != kUnvisited) {
+            continue;
+        }
+        regionQuery(p, scratch.neighbors);
+        for (uint32_t q : scratch.neighbors) {
+            if (isCore(q) && labels_[q] >= 0) {
+                assignPoint(p, labels_[q]);
+                break;
+            }
+        }
+        if (labels_[p] < 0) {
+            labels_[p] = kNoise;
+            num_noise_++;
+        }
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    float duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    
+    std::cout << "DBSCAN inserted " << (n - first_new) << " points in " << duration_ms << " ms" << std::endl;
+    std::cout << "Found " << num_clusters_ << " clusters" << std::endl;
+    std::cout << "Found " << num_noise_ << " noise points" << std::endl;
 }
 
-void DBSCAN::expandCluster(const std::vector<Gaussian>& gaussians, size_t point_idx, std::vector<size_t>& neighbors, int cluster_id) {
-    while (!neighbors.empty()) {
-        size_t current_idx = neighbors.back();
-        neighbors.pop_back();
+DBSCAN::Scratch& DBSCAN::threadScratch() {
+    thread_local Scratch scratch;
+    return scratch;
+}
+
+void DBSCAN::addPoints(std::span<const Gaussian> gaussians) {
+    const uint32_t first_point = static_cast<uint32_t>(labels_.size());
+    const size_t first_row = point_ids_.size();
+    
+    // Points below the opacity floor never reach the index or shape table,
+    // so every later query skips them for free
+    for (const auto& gaussian : gaussians) {
+        uint32_t point_idx = static_cast<uint32_t>(labels_.size());
+        float opacity = gaussian.getOpacity();
+        opacities_.push_back(opacity);
+        neighbor_weights_.push_back(0.0f);
         
-        if (labels_[current_idx] == -2) {
-            labels_[current_idx] = cluster_id; // Change noise to border point
-            num_noise_--;
+        if (opacity < opacity_floor_) {
+            labels_.push_back(kFiltered);
+            rows_.push_back(kNoRow);
+            num_filtered_++;
+            continue;
         }
         
-        if (labels_[current_idx] != -1) {
-            continue; // Already visited
+        labels_.push_back(kUnvisited);
+        rows_.push_back(index_.insert(gaussian.getPosition()));
+        point_ids_.push_back(point_idx);
+    }
+    
+    if (active_mode_ == DistanceMode::Anisotropic) {
+        std::vector<uint32_t> selection;
+        selection.reserve(point_ids_.size() - first_row);
+        for (size_t row = first_row; row < point_ids_.size(); ++row) {
+            selection.push_back(point_ids_[row] - first_point);
+        }
+        shape_.append(gaussians, selection);
+        max_bounding_radius_ = std::min(shape_.getMaxBoundingRadius(), radius_cap_);
+    }
+}
+
+float DBSCAN::sumNeighborWeights(const std::vector<uint32_t>& neighbors) const {
+    if (weighting_ == NeighborWeighting::Count) {
+        return static_cast<float>(neighbors.size());
+    }
+    float mass = 0.0f;
+    for (uint32_t idx : neighbors) {
+        mass += opacities_[idx];
+    }
+    return mass;
+}
+
+void DBSCAN::regionQuery(uint32_t point_idx, std::vector<uint32_t>& neighbors) const {
+    if (active_mode_ == DistanceMode::Anisotropic) {
+        anisotropicRegionQuery(point_idx, neighbors);
+        return;
+    }
+    
+    neighbors.clear();
+    const uint32_t row = rows_[point_idx];
+    index_.forEachInRadius(index_.getPosition(row), eps_, [&](uint32_t idx) {
+        if (idx != row) {
+            neighbors.push_back(point_ids_[idx]);
+        }
+    });
+}
+
+void DBSCAN::anisotropicRegionQuery(uint32_t point_idx, std::vector<uint32_t>& neighbors) const {
+    neighbors.clear();
+    
+    // Sphere test: a pair can only pass the ellipsoid test if the centers
+    // are within the larger of the two bounding radii
+    Scratch& scratch = threadScratch();
+    scratch.candidates.clear();
+    scratch.dx.clear();
+    scratch.dy.clear();
+    scratch.dz.clear();
+    
+    const uint32_t row = rows_[point_idx];
+    const Eigen::Vector3f& center = index_.getPosition(row);
+    const float eps_sq = eps_ * eps_;
+    const float radius = cappedRadius(row);
+    index_.forEachInRadius(center, std::max(eps_, max_bounding_radius_), [&](uint32_t idx) {
+        if (idx == row) {
+            return;
+        }
+        Eigen::Vector3f diff = index_.getPosition(idx) - center;
+        float dist_sq = diff.squaredNorm();
+        if (dist_sq <= eps_sq) {
+            neighbors.push_back(point_ids_[idx]);
+            return;
+        }
+        float pair_radius = std::max(radius, cappedRadius(idx));
+        if (dist_sq <= pair_radius * pair_radius) {
+            scratch.candidates.push_back(idx);
+            scratch.dx.push_back(diff.x());
+            scratch.dy.push_back(diff.y());
+            scratch.dz.push_back(diff.z());
+        }
+    });
+    
+    size_t count = scratch.candidates.size();
+    if (count == 0) {
+        return;
+    }
+    
+    // Gather candidate inverse covariances into SoA for the batched test
+    float a[6];
+    for (int k = 0; k < 6; ++k) {
+        const auto& column = shape_.getInverseCovariance(static_cast<GaussianAttributeTable::PackedIndex>(k));
+        a[k] = column[row];
+        scratch.inv_cov[k].resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            scratch.inv_cov[k][i] = column[scratch.candidates[i]];
+        }
+    }
+    scratch.accepted.resize(count);
+    
+    anisotropicAccept(
+        count, scratch.dx.data(), scratch.dy.data(), scratch.dz.data(), a,
+        scratch.inv_cov[0].data(), scratch.inv_cov[1].data(), scratch.inv_cov[2].data(),
+        scratch.inv_cov[3].data(), scratch.inv_cov[4].data(), scratch.inv_cov[5].data(),
+        mahalanobis_threshold_ * mahalanobis_threshold_, scratch.accepted.data()
+    );
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (scratch.accepted[i]) {
+            neighbors.push_back(point_ids_[scratch.candidates[i]]);
+        }
+    }
+}
+
+void DBSCAN::expandCluster(Scratch& scratch, int32_t cluster_id) {
+    while (!scratch.frontier.empty()) {
+        uint32_t current_idx = scratch.frontier.back();
+        scratch.frontier.pop_back();
+        
+        if (labels_[current_idx] == kNoise) {
+            labels_[current_idx] = cluster_id; // Change noise to border point
+            num_noise_--;
+            continue; // Noise points are known not to be core points
         }
         
         labels_[current_idx] = cluster_id;
         
-        std::vector<size_t> current_neighbors = regionQuery(gaussians, current_idx);
-        if (current_neighbors.size() >= static_cast<size_t>(min_pts_)) {
-            // Merge neighbors
-            for (size_t neighbor_idx : current_neighbors) {
-                if (labels_[neighbor_idx] == -1) {
-                    neighbors.push_back(neighbor_idx);
+        regionQuery(current_idx, scratch.neighbors);
+        neighbor_weights_[current_idx] = sumNeighborWeights(scratch.neighbors);
+        if (isCore(current_idx)) {
+            // Merge neighbors that have not been queued yet
+            for (uint32_t neighbor_idx : scratch.neighbors) {
+                if (!testAndSetBit(scratch.queued, neighbor_idx)) {
+                    scratch.frontier.push_back(neighbor_idx);
                 }
             }
         }
     }
 }
 
-float DBSCAN::computeDistance(const Gaussian& a, const Gaussian& b) {
-    // Use Euclidean distance between positions
-    Eigen::Vector3f diff = a.getPosition() - b.getPosition();
-    return diff.norm();
+void DBSCAN::assignPoint(uint32_t point_idx, int32_t cluster_id) {
+    if (labels_[point_idx] == kNoise) {
+        num_noise_--;
+    }
+    labels_[point_idx] = cluster_id;
+    clusters_[cluster_id].push_back(point_idx);
+}
+
+int32_t DBSCAN::mergeClusters(int32_t a, int32_t b) {
+    // Keep the larger cluster's id so the fewest labels change
+    if (clusters_[a].size() < clusters_[b].size()) {
+        std::swap(a, b);
+    }
+    for (size_t idx : clusters_[b]) {
+        labels_[idx] = a;
+    }
+    clusters_[a].insert(clusters_[a].end(), clusters_[b].begin(), clusters_[b].end());
+    clusters_[b].clear();
+    clusters_[b].shrink_to_fit();
+    num_clusters_--;
+    return a;
 }
 
 } // namespace AmeScanner
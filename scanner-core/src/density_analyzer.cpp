@@ -1,11 +1,81 @@
 #include "density_analyzer.h"
+#include "thread_pool.h"
+#include "union_find.h"
+#include "mapped_density_field.h"
 #include <iostream>
 #include <chrono>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 
 namespace AmeScanner {
 
+namespace {
+
+// Stable LSD radix sort on the 64-bit key, one byte per pass. Bytes that
+// are equal across all keys are skipped, which leaves few passes for the
+// small tile coordinates of typical scenes.
+void radixSortByKey(std::vector<std::pair<uint64_t, uint32_t>>& pairs) {
+    uint64_t all_or = 0, all_and = ~uint64_t(0);
+    for (const auto& entry : pairs) {
+        all_or |= entry.first;
+        all_and &= entry.first;
+    }
+    
+    std::vector<std::pair<uint64_t, uint32_t>> buffer(pairs.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        if ((((all_or ^ all_and) >> shift) & 0xFF) == 0) {
+            continue;
+        }
+        size_t counts[257] = {};
+        for (const auto& entry : pairs) {
+            counts[((entry.first >> shift) & 0xFF) + 1]++;
+        }
+        for (int digit = 0; digit < 256; ++digit) {
+            counts[digit + 1] += counts[digit];
+        }
+        for (const auto& entry : pairs) {
+            buffer[counts[(entry.first >> shift) & 0xFF]++] = entry;
+        }
+        pairs.swap(buffer);
+    }
+}
+
+// Bricks needed to cover a dense grid
+Eigen::Vector3i denseBrickDims(const Eigen::Vector3i& grid_dims) {
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    return (grid_dims + Eigen::Vector3i::Constant(kBrickSize - 1)) / kBrickSize;
+}
+
+// Coordinate of brick b when the bricks of a dense grid are numbered x fastest
+Eigen::Vector3i denseBrickCoord(size_t b, const Eigen::Vector3i& brick_dims) {
+    return Eigen::Vector3i(
+        static_cast<int>(b % brick_dims.x()),
+        static_cast<int>((b / brick_dims.x()) % brick_dims.y()),
+        static_cast<int>(b / (static_cast<size_t>(brick_dims.x()) * brick_dims.y()))
+    );
+}
+
+// Call fn(index in brick, index in grid) for each voxel of a brick that lies
+// inside the dense grid
+template <typename Fn>
+void forEachBrickVoxel(const Eigen::Vector3i& brick_coord, const Eigen::Vector3i& grid_dims, Fn&& fn) {
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    Eigen::Vector3i first = brick_coord * kBrickSize;
+    Eigen::Vector3i last = (first + Eigen::Vector3i::Constant(kBrickSize - 1)).cwiseMin(grid_dims - Eigen::Vector3i::Ones());
+    for (int z = first.z(); z <= last.z(); ++z) {
+        for (int y = first.y(); y <= last.y(); ++y) {
+            for (int x = first.x(); x <= last.x(); ++x) {
+                fn(((z - first.z()) * kBrickSize + (y - first.y())) * kBrickSize + (x - first.x()),
+                   static_cast<size_t>(x) + static_cast<size_t>(y) * grid_dims.x() +
+                   static_cast<size_t>(z) * grid_dims.x() * grid_dims.y());
+            }
+        }
+    }
+}
+
+} // namespace
+
 std::vector<float> DensityAnalyzer::computeDensityField(
     const std::vector<Gaussian>& gaussians,
     Eigen::Vector3f& min_bounds,
@@ -14,41 +84,28 @@ std::vector<float> DensityAnalyzer::computeDensityField(
 ) {
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    // Compute scene bounds
-    min_bounds = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
-    max_bounds = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
-    
-    for (const auto& gaussian : gaussians) {
-        const auto& pos = gaussian.getPosition();
-        min_bounds = min_bounds.cwiseMin(pos);
-        max_bounds = max_bounds.cwiseMax(pos);
-    }
+    computeBounds(gaussians, min_bounds, max_bounds, grid_dims);
+    SparseDensityField field;
+    buildSparseField(gaussians, min_bounds, grid_dims, field);
     
-    // Expand bounds slightly to include all points
-    min_bounds -= Eigen::Vector3f::Constant(grid_size_);
-    max_bounds += Eigen::Vector3f::Constant(grid_size_);
-    
-    // Compute grid dimensions
-    Eigen::Vector3f extent = max_bounds - min_bounds;
-    grid_dims = (extent / grid_size_).cast<int>() + Eigen::Vector3i::Ones();
-    
-    // Initialize density field
-    size_t num_voxels = grid_dims.x() * grid_dims.y() * grid_dims.z();
+    // Expand the bricks into the dense grid; bricks never overlap
+    size_t num_voxels = static_cast<size_t>(grid_dims.x()) * grid_dims.y() * grid_dims.z();
     std::vector<float> density_field(num_voxels, 0.0f);
     
-    // Compute density for each voxel
-    for (int x = 0; x < grid_dims.x(); ++x) {
-        for (int y = 0; y < grid_dims.y(); ++y) {
-            for (int z = 0; z < grid_dims.z(); ++z) {
-                Eigen::Vector3i grid_index(x, y, z);
-                Eigen::Vector3f point = getGridCenter(grid_index, min_bounds);
-                
-                float density = computeDensityAtPoint(gaussians, point);
-                size_t linear_index = getLinearIndex(grid_index, grid_dims);
-                density_field[linear_index] = density;
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    ThreadPool::global().parallelFor(field.getNumBricks(), 64, [&](size_t begin, size_t end, size_t) {
+        for (size_t b = begin; b < end; ++b) {
+            Eigen::Vector3i first = field.getBrickCoord(b) * kBrickSize;
+            Eigen::Vector3i last = (first + Eigen::Vector3i::Constant(kBrickSize - 1)).cwiseMin(grid_dims - Eigen::Vector3i::Ones());
+            const float* values = field.getBrickValues(b);
+            for (int z = first.z(); z <= last.z(); ++z) {
+                for (int y = first.y(); y <= last.y(); ++y) {
+                    const float* row = values + ((z - first.z()) * kBrickSize + (y - first.y())) * kBrickSize;
+                    std::copy(row, row + (last.x() - first.x() + 1), density_field.begin() + getLinearIndex(Eigen::Vector3i(first.x(), y, z), grid_dims));
+                }
             }
         }
-    }
+    });
     
     // Compute statistics
     computeStatistics(density_field);
@@ -63,23 +120,273 @@ std::vector<float> DensityAnalyzer::computeDensityField(
     return density_field;
 }
 
+SparseDensityField DensityAnalyzer::computeSparseDensityField(const std::vector<Gaussian>& gaussians) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    computeBounds(gaussians, min_bounds, max_bounds, grid_dims);
+    SparseDensityField field;
+    buildSparseField(gaussians, min_bounds, grid_dims, field);
+    
+    // Statistics cover the stored voxels only
+    computeStatistics(field.getValues());
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    float duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    
+    std::cout << "Sparse density field computed in " << duration_ms << " ms" << std::endl;
+    std::cout << "Grid dimensions: " << grid_dims.x() << " x " << grid_dims.y() << " x " << grid_dims.z() << std::endl;
+    std::cout << "Stored bricks: " << field.getNumBricks() << " (" << field.getMemoryUsage() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    
+    return field;
+}
+
 float DensityAnalyzer::computeDensityAtPoint(const std::vector<Gaussian>& gaussians, const Eigen::Vector3f& point) {
-    float density = 0.0f;
+    return computeDensityAtPoints(gaussians, std::span<const Eigen::Vector3f>(&point, 1))[0];
+}
+
+std::vector<float> DensityAnalyzer::computeDensityAtPoints(const std::vector<Gaussian>& gaussians, std::span<const Eigen::Vector3f> points) {
+    std::vector<float> densities(points.size(), 0.0f);
+    if (points.empty()) {
+        return densities;
+    }
+    IsotropicKernelData kernel;
+    kernel.build(gaussians, cutoff_sigmas_);
+    GaussianAttributeTable shape(cutoff_sigmas_);
+    if (kernel_mode_ == KernelMode::Anisotropic) {
+        shape.build(gaussians);
+    }
+    
+    ThreadPool::global().parallelFor(points.size(), 64, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            const Eigen::Vector3f& point = points[i];
+            if (kernel_mode_ == KernelMode::Anisotropic) {
+                densities[i] = evaluateAnisotropicDensity(kernel, shape, cutoff_sigmas_, point.x(), point.y(), point.z());
+            } else {
+                densities[i] = evaluateIsotropicDensity(
+                    kernel.size(), kernel.x.data(), kernel.y.data(), kernel.z.data(),
+                    kernel.opacity.data(), kernel.inv_two_sigma_sq.data(), kernel.cutoff_sq.data(),
+                    point.x(), point.y(), point.z()
+                );
+            }
+        }
+    });
+    return densities;
+}
+
+void DensityAnalyzer::computeBounds(
+    const std::vector<Gaussian>& gaussians,
+    Eigen::Vector3f& min_bounds,
+    Eigen::Vector3f& max_bounds,
+    Eigen::Vector3i& grid_dims
+) const {
+    // Compute scene bounds
+    min_bounds = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    max_bounds = Eigen::Vector3f::Constant(std::numeric_limits<float>::lowest());
     
     for (const auto& gaussian : gaussians) {
         const auto& pos = gaussian.getPosition();
-        float opacity = gaussian.getOpacity();
-        
-        // Compute distance from point to gaussian center
-        float dist = (point - pos).norm();
-        
-        // Compute density contribution using Gaussian falloff
-        float scale = gaussian.getScale().mean();
-        float falloff = std::exp(-0.5f * (dist * dist) / (scale * scale));
-        density += opacity * falloff;
+        min_bounds = min_bounds.cwiseMin(pos);
+        max_bounds = max_bounds.cwiseMax(pos);
+    }
+    if (gaussians.empty()) {
+        min_bounds.setZero();
+        max_bounds.setZero();
+    }
+    
+    // Expand bounds slightly to include all points
+    min_bounds -= Eigen::Vector3f::Constant(grid_size_);
+    max_bounds += Eigen::Vector3f::Constant(grid_size_);
+    
+    // Compute grid dimensions in double so far outliers cannot overflow int;
+    // anything past the largest brick-addressable extent is clipped
+    Eigen::Vector3d cells = ((max_bounds - min_bounds).cast<double>() / grid_size_).array().floor() + 1.0;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (cells[axis] > SparseDensityField::kMaxVoxelsPerAxis) {
+            std::cerr << "Scene spans " << cells[axis] << " voxels along axis " << axis
+                      << "; clipping to " << SparseDensityField::kMaxVoxelsPerAxis << std::endl;
+            cells[axis] = SparseDensityField::kMaxVoxelsPerAxis;
+        }
+    }
+    grid_dims = cells.cast<int>();
+}
+
+void DensityAnalyzer::buildSparseField(
+    const std::vector<Gaussian>& gaussians,
+    const Eigen::Vector3f& min_bounds,
+    const Eigen::Vector3i& grid_dims,
+    SparseDensityField& field
+) const {
+    field.reset(min_bounds, grid_size_, grid_dims);
+    ThreadPool& pool = ThreadPool::global();
+    
+    // Per-gaussian kernel parameters, computed once instead of per voxel.
+    // The anisotropic mode adds inverse covariances and oriented extents.
+    const bool anisotropic = kernel_mode_ == KernelMode::Anisotropic;
+    IsotropicKernelData kernel;
+    kernel.build(gaussians, cutoff_sigmas_);
+    GaussianAttributeTable shape(cutoff_sigmas_);
+    if (anisotropic) {
+        shape.build(gaussians);
+    }
+    
+    // Voxel footprint of every gaussian and the number of tiles it overlaps
+    std::vector<Eigen::Vector3i> voxel_lo(gaussians.size()), voxel_hi(gaussians.size());
+    std::vector<size_t> pair_offsets(gaussians.size() + 1, 0);
+    pool.parallelFor(gaussians.size(), 4096, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            Eigen::Vector3f half_extent;
+            if (anisotropic) {
+                half_extent = Eigen::Vector3f(shape.getExtentX()[i], shape.getExtentY()[i], shape.getExtentZ()[i]);
+            } else if (kernel.cutoff_sq[i] >= 0.0f) {
+                half_extent = Eigen::Vector3f::Constant(std::sqrt(kernel.cutoff_sq[i]));
+            } else {
+                continue;
+            }
+            Eigen::Vector3f center(kernel.x[i], kernel.y[i], kernel.z[i]);
+            if (computeFootprint(center, half_extent, min_bounds, grid_dims, voxel_lo[i], voxel_hi[i])) {
+                Eigen::Vector3i tiles = voxel_hi[i] / kTileSize - voxel_lo[i] / kTileSize + Eigen::Vector3i::Ones();
+                pair_offsets[i + 1] = static_cast<size_t>(tiles.x()) * tiles.y() * tiles.z();
+            }
+        }
+    });
+    for (size_t i = 0; i < gaussians.size(); ++i) {
+        pair_offsets[i + 1] += pair_offsets[i];
+    }
+    
+    // (tile key, gaussian) pairs sorted by key give a CSR binning over the
+    // occupied tiles only. Gaussians stay in input order within each bin,
+    // so every voxel sums its contributions in the same order regardless
+    // of thread count.
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(pair_offsets.back());
+    pool.parallelFor(gaussians.size(), 4096, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            if (pair_offsets[i] == pair_offsets[i + 1]) {
+                continue;
+            }
+            Eigen::Vector3i tile_lo = voxel_lo[i] / kTileSize, tile_hi = voxel_hi[i] / kTileSize;
+            size_t cursor = pair_offsets[i];
+            for (int tz = tile_lo.z(); tz <= tile_hi.z(); ++tz) {
+                for (int ty = tile_lo.y(); ty <= tile_hi.y(); ++ty) {
+                    for (int tx = tile_lo.x(); tx <= tile_hi.x(); ++tx) {
+                        pairs[cursor++] = {packTileKey(Eigen::Vector3i(tx, ty, tz)), static_cast<uint32_t>(i)};
+                    }
+                }
+            }
+        }
+    });
+    radixSortByKey(pairs);
+    
+    std::vector<size_t> tile_offsets;
+    for (size_t k = 0; k < pairs.size(); ++k) {
+        if (k == 0 || pairs[k].first != pairs[k - 1].first) {
+            tile_offsets.push_back(k);
+        }
     }
+    const size_t num_tiles = tile_offsets.size();
+    tile_offsets.push_back(pairs.size());
     
-    return density;
+    // Each tile is owned by exactly one worker, so no atomics are needed.
+    // Tiles accumulate into a per-worker block whose x-rows are the SIMD
+    // width of the kernel, then split it into bricks.
+    static_assert(kTileSize == kDensityBlockSize, "tiles must match the block kernel");
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    constexpr int kBricksPerTile = kTileSize / kBrickSize;
+    constexpr size_t kTileBricks = kBricksPerTile * kBricksPerTile * kBricksPerTile;
+    const size_t block_voxels = static_cast<size_t>(kTileSize) * kTileSize * kTileSize;
+    std::vector<float> blocks(pool.getNumThreads() * block_voxels);
+    std::vector<float> brick_values(num_tiles * block_voxels);
+    std::vector<uint8_t> keep_brick(num_tiles * kTileBricks, 0);
+    
+    pool.parallelFor(num_tiles, 1, [&](size_t begin, size_t end, size_t worker_id) {
+        float* block = blocks.data() + worker_id * block_voxels;
+        for (size_t t = begin; t < end; ++t) {
+            Eigen::Vector3i clip_lo = unpackTileKey(pairs[tile_offsets[t]].first) * kTileSize;
+            Eigen::Vector3i clip_hi = (clip_lo + Eigen::Vector3i::Constant(kTileSize - 1)).cwiseMin(grid_dims - Eigen::Vector3i::Ones());
+            Eigen::Vector3f origin = getGridCenter(clip_lo, min_bounds);
+            
+            std::fill(block, block + block_voxels, 0.0f);
+            for (size_t k = tile_offsets[t]; k < tile_offsets[t + 1]; ++k) {
+                uint32_t i = pairs[k].second;
+                Eigen::Vector3i lo = voxel_lo[i].cwiseMax(clip_lo) - clip_lo;
+                Eigen::Vector3i hi = voxel_hi[i].cwiseMin(clip_hi) - clip_lo;
+                if (anisotropic) {
+                    accumulateAnisotropicBlockDensity(kernel, shape, i, cutoff_sigmas_, origin.data(), grid_size_, lo.y(), hi.y(), lo.z(), hi.z(), block);
+                } else {
+                    accumulateBlockDensity(kernel, i, origin.data(), grid_size_, lo.y(), hi.y(), lo.z(), hi.z(), block);
+                }
+            }
+            
+            // Rows are evaluated across the whole tile width; voxels past the
+            // grid edge are zeroed so they read like voxels in missing bricks
+            const int valid_x = clip_hi.x() - clip_lo.x() + 1;
+            if (valid_x < kTileSize) {
+                for (size_t row = 0; row < block_voxels; row += kTileSize) {
+                    std::fill(block + row + valid_x, block + row + kTileSize, 0.0f);
+                }
+            }
+            
+            for (size_t sub = 0; sub < kTileBricks; ++sub) {
+                const int ox = static_cast<int>(sub % kBricksPerTile) * kBrickSize;
+                const int oy = static_cast<int>((sub / kBricksPerTile) % kBricksPerTile) * kBrickSize;
+                const int oz = static_cast<int>(sub / (kBricksPerTile * kBricksPerTile)) * kBrickSize;
+                float* brick = brick_values.data() + (t * kTileBricks + sub) * SparseDensityField::kBrickVoxels;
+                for (int z = 0; z < kBrickSize; ++z) {
+                    for (int y = 0; y < kBrickSize; ++y) {
+                        const float* row = block + (static_cast<size_t>(oz + z) * kTileSize + (oy + y)) * kTileSize + ox;
+                        std::copy(row, row + kBrickSize, brick + (z * kBrickSize + y) * kBrickSize);
+                    }
+                }
+                float brick_max = *std::max_element(brick, brick + SparseDensityField::kBrickVoxels);
+                keep_brick[t * kTileBricks + sub] = brick_max > sparse_epsilon_;
+            }
+        }
+    });
+    
+    field.reserve(std::count(keep_brick.begin(), keep_brick.end(), 1));
+    for (size_t t = 0; t < num_tiles; ++t) {
+        Eigen::Vector3i tile = unpackTileKey(pairs[tile_offsets[t]].first);
+        for (size_t sub = 0; sub < kTileBricks; ++sub) {
+            if (keep_brick[t * kTileBricks + sub]) {
+                Eigen::Vector3i offset(sub % kBricksPerTile, (sub / kBricksPerTile) % kBricksPerTile, sub / (kBricksPerTile * kBricksPerTile));
+                field.addBrick(tile * kBricksPerTile + offset, brick_values.data() + (t * kTileBricks + sub) * SparseDensityField::kBrickVoxels);
+            }
+        }
+    }
+    field.buildPyramid();
+}
+
+uint64_t DensityAnalyzer::packTileKey(const Eigen::Vector3i& tile) {
+    // z-major so sorted keys walk tiles in memory order
+    return (static_cast<uint64_t>(tile.z()) << 42) |
+           (static_cast<uint64_t>(tile.y()) << 21) |
+           static_cast<uint64_t>(tile.x());
+}
+
+Eigen::Vector3i DensityAnalyzer::unpackTileKey(uint64_t key) {
+    constexpr uint64_t kMask = (uint64_t(1) << 21) - 1;
+    return Eigen::Vector3i(
+        static_cast<int>(key & kMask),
+        static_cast<int>((key >> 21) & kMask),
+        static_cast<int>(key >> 42)
+    );
+}
+
+bool DensityAnalyzer::computeFootprint(
+    const Eigen::Vector3f& center,
+    const Eigen::Vector3f& half_extent,
+    const Eigen::Vector3f& min_bounds,
+    const Eigen::Vector3i& grid_dims,
+    Eigen::Vector3i& lo,
+    Eigen::Vector3i& hi
+) const {
+    // Voxel centers lie at min_bounds + (i + 0.5) * grid_size
+    Eigen::Vector3f lo_f = (center - min_bounds - half_extent) / grid_size_ - Eigen::Vector3f::Constant(0.5f);
+    Eigen::Vector3f hi_f = (center - min_bounds + half_extent) / grid_size_ - Eigen::Vector3f::Constant(0.5f);
+    lo = lo_f.array().ceil().cast<int>().max(0).matrix();
+    hi = hi_f.array().floor().cast<int>().min((grid_dims - Eigen::Vector3i::Ones()).array()).matrix();
+    return (lo.array() <= hi.array()).all();
 }
 
 std::vector<Eigen::Vector3f> DensityAnalyzer::findDenseRegions(
@@ -109,63 +416,435 @@ std::vector<Eigen::Vector3f> DensityAnalyzer::findDenseRegions(
     return dense_regions;
 }
 
+std::vector<Eigen::Vector3f> DensityAnalyzer::findDenseRegions(
+    const SparseDensityField& field,
+    float density_threshold
+) {
+    std::vector<Eigen::Vector3f> dense_regions;
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    
+    // Only bricks the pyramid cannot rule out are scanned
+    std::vector<uint32_t> bricks;
+    field.collectBricks(density_threshold, bricks);
+    for (uint32_t b : bricks) {
+        const Eigen::Vector3i first = field.getBrickCoord(b) * kBrickSize;
+        const float* values = field.getBrickValues(b);
+        for (int z = 0; z < kBrickSize; ++z) {
+            for (int y = 0; y < kBrickSize; ++y) {
+                for (int x = 0; x < kBrickSize; ++x) {
+                    if (values[(z * kBrickSize + y) * kBrickSize + x] >= density_threshold) {
+                        dense_regions.push_back(field.getVoxelCenter(first + Eigen::Vector3i(x, y, z)));
+                    }
+                }
+            }
+        }
+    }
+    
+    std::cout << "Found " << dense_regions.size() << " dense regions above threshold " << density_threshold << std::endl;
+    
+    return dense_regions;
+}
+
+size_t DensityAnalyzer::countDenseVoxels(const SparseDensityField& field, float density_threshold) const {
+    std::vector<uint32_t> bricks;
+    field.collectBricks(density_threshold, bricks);
+    
+    size_t count = 0;
+    for (uint32_t b : bricks) {
+        const float* values = field.getBrickValues(b);
+        count += std::count_if(values, values + SparseDensityField::kBrickVoxels,
+                               [density_threshold](float value) { return value >= density_threshold; });
+    }
+    return count;
+}
+
+std::vector<DensityAnalyzer::DenseRegion> DensityAnalyzer::labelDenseRegions(
+    const SparseDensityField& field,
+    float density_threshold,
+    std::vector<int32_t>* voxel_labels
+) {
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    constexpr size_t kBrickVoxels = SparseDensityField::kBrickVoxels;
+    const size_t num_voxels = field.getNumBricks() * kBrickVoxels;
+    if (num_voxels > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Too many stored voxels to label: " << num_voxels << std::endl;
+        return {};
+    }
+    
+    // Union-find elements are stored voxels: brick * kBrickVoxels + local
+    // index. Each brick unites its own voxels, then its +x/+y/+z faces with
+    // the neighbouring bricks; the face unions race with the neighbours'
+    // own passes, which the concurrent union-find allows.
+    ConcurrentUnionFind sets(num_voxels);
+    const auto values = field.getValues();
+    auto localIndex = [](int x, int y, int z) { return (z * kBrickSize + y) * kBrickSize + x; };
+    
+    std::vector<uint32_t> bricks;
+    field.collectBricks(density_threshold, bricks);
+    ThreadPool::global().parallelFor(bricks.size(), 16, [&](size_t begin, size_t end, size_t) {
+        for (size_t k = begin; k < end; ++k) {
+            const size_t b = bricks[k];
+            const uint32_t base = static_cast<uint32_t>(b * kBrickVoxels);
+            const float* brick = field.getBrickValues(b);
+            
+            for (int z = 0; z < kBrickSize; ++z) {
+                for (int y = 0; y < kBrickSize; ++y) {
+                    for (int x = 0; x < kBrickSize; ++x) {
+                        int v = localIndex(x, y, z);
+                        if (brick[v] < density_threshold) {
+                            continue;
+                        }
+                        if (x + 1 < kBrickSize && brick[v + 1] >= density_threshold) {
+                            sets.unite(base + v, base + v + 1);
+                        }
+                        if (y + 1 < kBrickSize && brick[v + kBrickSize] >= density_threshold) {
+                            sets.unite(base + v, base + v + kBrickSize);
+                        }
+                        if (z + 1 < kBrickSize && brick[v + kBrickSize * kBrickSize] >= density_threshold) {
+                            sets.unite(base + v, base + v + kBrickSize * kBrickSize);
+                        }
+                    }
+                }
+            }
+            
+            for (int axis = 0; axis < 3; ++axis) {
+                int64_t neighbor = field.findBrick(field.getBrickCoord(b) + Eigen::Vector3i::Unit(axis));
+                if (neighbor == SparseDensityField::kNoBrick || field.getBrickMax(static_cast<size_t>(neighbor)) < density_threshold) {
+                    continue;
+                }
+                const uint32_t neighbor_base = static_cast<uint32_t>(neighbor * kBrickVoxels);
+                const float* neighbor_brick = field.getBrickValues(static_cast<size_t>(neighbor));
+                for (int i = 0; i < kBrickSize; ++i) {
+                    for (int j = 0; j < kBrickSize; ++j) {
+                        Eigen::Vector3i inner;
+                        inner[axis] = kBrickSize - 1;
+                        inner[(axis + 1) % 3] = i;
+                        inner[(axis + 2) % 3] = j;
+                        Eigen::Vector3i outer = inner;
+                        outer[axis] = 0;
+                        int u = localIndex(inner.x(), inner.y(), inner.z());
+                        int w = localIndex(outer.x(), outer.y(), outer.z());
+                        if (brick[u] >= density_threshold && neighbor_brick[w] >= density_threshold) {
+                            sets.unite(base + u, neighbor_base + w);
+                        }
+                    }
+                }
+            }
+        }
+    });
+    
+    // Every root is the smallest voxel of its set, so walking voxels in
+    // order meets each root before the rest of its set
+    std::vector<int32_t> labels(num_voxels, -1);
+    std::vector<DenseRegion> regions;
+    std::vector<Eigen::Vector3d> weighted_sums;
+    std::vector<double> masses;
+    std::vector<Eigen::Vector3i> voxel_min, voxel_max;
+    
+    for (uint32_t b : bricks) {
+        const Eigen::Vector3i first = field.getBrickCoord(b) * kBrickSize;
+        for (size_t v = 0; v < kBrickVoxels; ++v) {
+            size_t i = b * kBrickVoxels + v;
+            if (values[i] < density_threshold) {
+                continue;
+            }
+            uint32_t root = sets.find(static_cast<uint32_t>(i));
+            if (root == i) {
+                labels[i] = static_cast<int32_t>(regions.size());
+                regions.emplace_back();
+                weighted_sums.push_back(Eigen::Vector3d::Zero());
+                masses.push_back(0.0);
+                voxel_min.push_back(Eigen::Vector3i::Constant(std::numeric_limits<int>::max()));
+                voxel_max.push_back(Eigen::Vector3i::Constant(std::numeric_limits<int>::lowest()));
+            } else {
+                labels[i] = labels[root];
+            }
+            
+            int32_t label = labels[i];
+            Eigen::Vector3i voxel = first + Eigen::Vector3i(v % kBrickSize, (v / kBrickSize) % kBrickSize, v / (kBrickSize * kBrickSize));
+            regions[label].voxel_count++;
+            masses[label] += values[i];
+            weighted_sums[label] += values[i] * field.getVoxelCenter(voxel).cast<double>();
+            voxel_min[label] = voxel_min[label].cwiseMin(voxel);
+            voxel_max[label] = voxel_max[label].cwiseMax(voxel);
+        }
+    }
+    
+    const float voxel_size = field.getVoxelSize();
+    const float voxel_volume = voxel_size * voxel_size * voxel_size;
+    for (size_t r = 0; r < regions.size(); ++r) {
+        DenseRegion& region = regions[r];
+        region.min_bounds = field.getOrigin() + voxel_min[r].cast<float>() * voxel_size;
+        region.max_bounds = field.getOrigin() + (voxel_max[r] + Eigen::Vector3i::Ones()).cast<float>() * voxel_size;
+        region.mass = static_cast<float>(masses[r] * voxel_volume);
+        region.centroid = masses[r] > 0.0 ? (weighted_sums[r] / masses[r]).cast<float>() : region.min_bounds;
+    }
+    
+    std::cout << "Labeled " << regions.size() << " dense regions above threshold " << density_threshold << std::endl;
+    
+    if (voxel_labels) {
+        *voxel_labels = std::move(labels);
+    }
+    return regions;
+}
+
+std::vector<DensityAnalyzer::DenseRegion> DensityAnalyzer::labelDenseRegions(
+    const std::vector<float>& density_field,
+    const Eigen::Vector3f& min_bounds,
+    const Eigen::Vector3i& grid_dims,
+    float density_threshold,
+    std::vector<int32_t>* voxel_labels
+) {
+    // Gather the bricks that reach the threshold and label those
+    SparseDensityField field;
+    std::vector<size_t> active_bricks = gatherDenseBricks(density_field, min_bounds, grid_dims, density_threshold, field);
+    
+    std::vector<int32_t> brick_labels;
+    auto regions = labelDenseRegions(field, density_threshold, voxel_labels ? &brick_labels : nullptr);
+    
+    if (voxel_labels) {
+        voxel_labels->assign(density_field.size(), -1);
+        const Eigen::Vector3i brick_dims = denseBrickDims(grid_dims);
+        for (size_t k = 0; k < active_bricks.size(); ++k) {
+            forEachBrickVoxel(denseBrickCoord(active_bricks[k], brick_dims), grid_dims, [&](size_t local, size_t linear) {
+                (*voxel_labels)[linear] = brick_labels[k * SparseDensityField::kBrickVoxels + local];
+            });
+        }
+    }
+    return regions;
+}
+
+bool DensityAnalyzer::saveDensityField(const std::string& file_path, const SparseDensityField& field) const {
+    Eigen::Vector3f max_bounds = field.getOrigin() + field.getDims().cast<float>() * field.getVoxelSize();
+    return writeDensityFieldFile(file_path, field, max_bounds);
+}
+
+bool DensityAnalyzer::saveDensityField(
+    const std::string& file_path,
+    const std::vector<float>& density_field,
+    const Eigen::Vector3f& min_bounds,
+    const Eigen::Vector3f& max_bounds,
+    const Eigen::Vector3i& grid_dims
+) const {
+    // Densities are never negative, so dropping the all-zero bricks is lossless
+    SparseDensityField field;
+    gatherDenseBricks(density_field, min_bounds, grid_dims, std::numeric_limits<float>::denorm_min(), field);
+    return writeDensityFieldFile(file_path, field, max_bounds);
+}
+
+std::vector<size_t> DensityAnalyzer::gatherDenseBricks(
+    const std::vector<float>& density_field,
+    const Eigen::Vector3f& min_bounds,
+    const Eigen::Vector3i& grid_dims,
+    float min_value,
+    SparseDensityField& field
+) const {
+    const Eigen::Vector3i brick_dims = denseBrickDims(grid_dims);
+    const size_t num_bricks = static_cast<size_t>(brick_dims.x()) * brick_dims.y() * brick_dims.z();
+    
+    std::vector<uint8_t> active(num_bricks, 0);
+    ThreadPool::global().parallelFor(num_bricks, 64, [&](size_t begin, size_t end, size_t) {
+        for (size_t b = begin; b < end; ++b) {
+            forEachBrickVoxel(denseBrickCoord(b, brick_dims), grid_dims, [&](size_t, size_t linear) {
+                active[b] |= density_field[linear] >= min_value;
+            });
+        }
+    });
+    
+    field.reset(min_bounds, grid_size_, grid_dims);
+    field.reserve(std::count(active.begin(), active.end(), 1));
+    std::vector<size_t> active_bricks;
+    float brick[SparseDensityField::kBrickVoxels];
+    for (size_t b = 0; b < num_bricks; ++b) {
+        if (!active[b]) {
+            continue;
+        }
+        Eigen::Vector3i brick_coord = denseBrickCoord(b, brick_dims);
+        std::fill(brick, brick + SparseDensityField::kBrickVoxels, 0.0f);
+        forEachBrickVoxel(brick_coord, grid_dims, [&](size_t local, size_t linear) { brick[local] = density_field[linear]; });
+        field.addBrick(brick_coord, brick);
+        active_bricks.push_back(b);
+    }
+    return active_bricks;
+}
+
+bool DensityAnalyzer::writeDensityFieldFile(
+    const std::string& file_path,
+    const SparseDensityField& field,
+    const Eigen::Vector3f& max_bounds
+) const {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    MappedDensityField::Header header = {};
+    for (int axis = 0; axis < 3; ++axis) {
+        header.max_bounds[axis] = max_bounds[axis];
+    }
+    header.min_density = stats_.min_density;
+    header.max_density = stats_.max_density;
+    header.mean_density = stats_.mean_density;
+    header.median_density = stats_.median_density;
+    header.p90_density = stats_.p90_density;
+    header.p99_density = stats_.p99_density;
+    header.std_dev_density = stats_.std_dev_density;
+    if (!MappedDensityField::write(file_path, header, field)) {
+        return false;
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    float duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    
+    std::cout << "Saved " << field.getNumBricks() << " density bricks to " << file_path << " in " << duration_ms << " ms" << std::endl;
+    return true;
+}
+
 Eigen::Vector3i DensityAnalyzer::getGridIndex(const Eigen::Vector3f& point, const Eigen::Vector3f& min_bounds) const {
     Eigen::Vector3f relative_pos = point - min_bounds;
     return (relative_pos / grid_size_).cast<int>();
 }
 
 size_t DensityAnalyzer::getLinearIndex(const Eigen::Vector3i& grid_index, const Eigen::Vector3i& grid_dims) const {
-    return grid_index.x() + grid_index.y() * grid_dims.x() + grid_index.z() * grid_dims.x() * grid_dims.y();
+    return static_cast<size_t>(grid_index.x()) +
+           static_cast<size_t>(grid_index.y()) * grid_dims.x() +
+           static_cast<size_t>(grid_index.z()) * grid_dims.x() * grid_dims.y();
 }
 
 Eigen::Vector3f DensityAnalyzer::getGridCenter(const Eigen::Vector3i& grid_index, const Eigen::Vector3f& min_bounds) const {
     return min_bounds + (grid_index.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * grid_size_;
 }
 
-void DensityAnalyzer::computeStatistics(const std::vector<float>& density_field) {
+void DensityAnalyzer::computeStatistics(std::span<const float> density_field) {
+    histogram_.assign(kHistogramBins, 0);
     if (density_field.empty()) {
-        stats_.min_density = 0.0f;
-        stats_.max_density = 0.0f;
-        stats_.mean_density = 0.0f;
-        stats_.median_density = 0.0f;
-        stats_.std_dev_density = 0.0f;
+        stats_ = Statistics{};
         return;
     }
     
-    // Compute min, max, mean
-    stats_.min_density = *std::min_element(density_field.begin(), density_field.end());
-    stats_.max_density = *std::max_element(density_field.begin(), density_field.end());
+    // One pass: every chunk keeps its own moments, each worker its own
+    // histogram. Chunks are merged in order so the result does not depend
+    // on the thread count.
+    constexpr size_t kChunkSize = size_t(1) << 16;
+    const size_t num_chunks = (density_field.size() + kChunkSize - 1) / kChunkSize;
+    std::vector<Moments> chunk_moments(num_chunks);
+    ThreadPool& pool = ThreadPool::global();
+    std::vector<std::vector<uint64_t>> worker_histograms(pool.getNumThreads());
     
-    float sum = 0.0f;
-    for (float density : density_field) {
-        sum += density;
-    }
-    stats_.mean_density = sum / density_field.size();
+    pool.parallelFor(num_chunks, 1, [&](size_t begin, size_t end, size_t worker_id) {
+        std::vector<uint64_t>& histogram = worker_histograms[worker_id];
+        if (histogram.empty()) {
+            histogram.assign(kHistogramBins, 0);
+        }
+        for (size_t c = begin; c < end; ++c) {
+            size_t first = c * kChunkSize;
+            size_t last = std::min(first + kChunkSize, density_field.size());
+            Moments& moments = chunk_moments[c];
+            for (size_t i = first; i < last; ++i) {
+                moments.add(density_field[i]);
+                histogram[histogramBin(density_field[i])]++;
+            }
+        }
+    });
     
-    // Compute median
-    std::vector<float> sorted_densities = density_field;
-    std::sort(sorted_densities.begin(), sorted_densities.end());
-    size_t mid = sorted_densities.size() / 2;
-    if (sorted_densities.size() % 2 == 0) {
-        stats_.median_density = (sorted_densities[mid - 1] + sorted_densities[mid]) / 2.0f;
-    } else {
-        stats_.median_density = sorted_densities[mid];
+    Moments total;
+    for (const Moments& moments : chunk_moments) {
+        total.merge(moments);
     }
-    
-    // Compute standard deviation
-    float sum_sq = 0.0f;
-    for (float density : density_field) {
-        float diff = density - stats_.mean_density;
-        sum_sq += diff * diff;
+    for (const auto& histogram : worker_histograms) {
+        for (size_t bin = 0; bin < histogram.size(); ++bin) {
+            histogram_[bin] += histogram[bin];
+        }
     }
-    stats_.std_dev_density = std::sqrt(sum_sq / density_field.size());
+    
+    stats_.min_density = total.min;
+    stats_.max_density = total.max;
+    stats_.mean_density = static_cast<float>(total.mean);
+    stats_.std_dev_density = static_cast<float>(std::sqrt(total.m2 / total.count));
+    stats_.median_density = getPercentile(0.5f);
+    stats_.p90_density = getPercentile(0.9f);
+    stats_.p99_density = getPercentile(0.99f);
     
     std::cout << "Density statistics:" << std::endl;
     std::cout << "  Min density: " << stats_.min_density << std::endl;
     std::cout << "  Max density: " << stats_.max_density << std::endl;
     std::cout << "  Mean density: " << stats_.mean_density << std::endl;
     std::cout << "  Median density: " << stats_.median_density << std::endl;
+    std::cout << "  P90 density: " << stats_.p90_density << std::endl;
+    std::cout << "  P99 density: " << stats_.p99_density << std::endl;
     std::cout << "  Std dev density: " << stats_.std_dev_density << std::endl;
 }
 
+float DensityAnalyzer::getPercentile(float q) const {
+    uint64_t count = 0;
+    for (uint64_t bin_count : histogram_) {
+        count += bin_count;
+    }
+    if (count == 0) {
+        return 0.0f;
+    }
+    
+    // Interpolate linearly by rank inside the bin holding the target rank
+    double rank = std::clamp(static_cast<double>(q), 0.0, 1.0) * (count - 1);
+    uint64_t seen = 0;
+    for (size_t bin = 0; bin < histogram_.size(); ++bin) {
+        if (histogram_[bin] == 0 || seen + histogram_[bin] <= rank) {
+            seen += histogram_[bin];
+            continue;
+        }
+        float lo = histogramBinStart(bin);
+        float hi = bin + 1 < histogram_.size() ? histogramBinStart(bin + 1) : lo;
+        // Bins narrower than a normal float hold zero and denormals only
+        if (!std::isfinite(lo) || !std::isfinite(hi) || hi - lo < std::numeric_limits<float>::min()) {
+            hi = lo;
+        }
+        double fraction = (rank - seen + 0.5) / histogram_[bin];
+        float value = static_cast<float>(lo + (hi - lo) * fraction);
+        return std::clamp(value, stats_.min_density, stats_.max_density);
+    }
+    return stats_.max_density;
+}
+
+void DensityAnalyzer::Moments::add(float value) {
+    count++;
+    double delta = value - mean;
+    mean += delta / count;
+    m2 += delta * (value - mean);
+    min = std::min(min, value);
+    max = std::max(max, value);
+}
+
+void DensityAnalyzer::Moments::merge(const Moments& other) {
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    
+    // Chan et al. pairwise update
+    size_t merged = count + other.count;
+    double delta = other.mean - mean;
+    mean += delta * other.count / merged;
+    m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / merged);
+    count = merged;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+size_t DensityAnalyzer::histogramBin(float value) {
+    // Map the float bits to an unsigned key that sorts like the value, then
+    // keep the top bits: sign, exponent and the leading mantissa bits
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    return bits >> (32 - kHistogramBits);
+}
+
+float DensityAnalyzer::histogramBinStart(size_t bin) {
+    uint32_t bits = static_cast<uint32_t>(bin) << (32 - kHistogramBits);
+    bits = (bits & 0x80000000u) ? (bits & 0x7FFFFFFFu) : ~bits;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
 } // namespace AmeScanner
@@ -0,0 +1,214 @@
+#include "density_kernel.h"
+#include "simd_dispatch.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace AmeScanner {
+
+namespace {
+
+// Fixed lane count for partial sums, so every dispatch target adds the
+// same terms in the same order
+constexpr size_t kLanes = 16;
+
+inline float sumLanes(const float* lanes) {
+    float total = 0.0f;
+    for (size_t l = 0; l < kLanes; ++l) {
+        total += lanes[l];
+    }
+    return total;
+}
+
+} // namespace
+
+void IsotropicKernelData::build(std::span<const Gaussian> gaussians, float cutoff_sigmas) {
+    const size_t n = gaussians.size();
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    opacity.resize(n);
+    inv_two_sigma_sq.resize(n);
+    cutoff_sq.resize(n);
+    
+    ThreadPool::global().parallelFor(n, 4096, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            const Gaussian& gaussian = gaussians[i];
+            Eigen::Vector3f pos = gaussian.getPosition();
+            float sigma = gaussian.getScale().mean();
+            
+            x[i] = pos.x();
+            y[i] = pos.y();
+            z[i] = pos.z();
+            opacity[i] = gaussian.getOpacity();
+            if (sigma > 0.0f) {
+                inv_two_sigma_sq[i] = 0.5f / (sigma * sigma);
+                cutoff_sq[i] = cutoff_sigmas * cutoff_sigmas * sigma * sigma;
+            } else {
+                inv_two_sigma_sq[i] = 0.0f;
+                cutoff_sq[i] = -1.0f;
+            }
+        }
+    });
+}
+
+AME_SIMD_CLONES
+float evaluateIsotropicDensity(
+    size_t count,
+    const float* x, const float* y, const float* z,
+    const float* opacity, const float* inv_two_sigma_sq, const float* cutoff_sq,
+    float px, float py, float pz
+) {
+    float lanes[kLanes] = {};
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            float dx = px - x[i + l], dy = py - y[i + l], dz = pz - z[i + l];
+            float dist_sq = dx * dx + dy * dy + dz * dz;
+            float value = opacity[i + l] * fastExp(-dist_sq * inv_two_sigma_sq[i + l]);
+            lanes[l] += dist_sq <= cutoff_sq[i + l] ? value : 0.0f;
+        }
+    }
+    for (size_t l = 0; i < count; ++i, ++l) {
+        float dx = px - x[i], dy = py - y[i], dz = pz - z[i];
+        float dist_sq = dx * dx + dy * dy + dz * dz;
+        float value = opacity[i] * fastExp(-dist_sq * inv_two_sigma_sq[i]);
+        lanes[l] += dist_sq <= cutoff_sq[i] ? value : 0.0f;
+    }
+    return sumLanes(lanes);
+}
+
+AME_SIMD_CLONES
+void accumulateBlockDensity(
+    const IsotropicKernelData& data, size_t index,
+    const float origin[3], float spacing,
+    int y_lo, int y_hi, int z_lo, int z_hi,
+    float* block
+) {
+    const float cx = data.x[index], cy = data.y[index], cz = data.z[index];
+    const float k = data.inv_two_sigma_sq[index];
+    const float cutoff_sq = data.cutoff_sq[index];
+    const float opacity = data.opacity[index];
+    
+    float dx_sq[kDensityBlockSize];
+    float falloff_x[kDensityBlockSize];
+    for (int v = 0; v < kDensityBlockSize; ++v) {
+        float dx = origin[0] + v * spacing - cx;
+        dx_sq[v] = dx * dx;
+        falloff_x[v] = fastExp(-dx_sq[v] * k);
+    }
+    
+    // exp(-(dx^2 + dyz^2) k) = exp(-dx^2 k) * exp(-dyz^2 k), so each row
+    // only scales the shared x falloff
+    for (int z = z_lo; z <= z_hi; ++z) {
+        float dz = origin[2] + z * spacing - cz;
+        for (int y = y_lo; y <= y_hi; ++y) {
+            float dy = origin[1] + y * spacing - cy;
+            float dyz_sq = dy * dy + dz * dz;
+            float limit_sq = cutoff_sq - dyz_sq;
+            if (limit_sq < 0.0f) {
+                continue;
+            }
+            
+            float weight = opacity * fastExp(-dyz_sq * k);
+            float* row = block + (static_cast<size_t>(z) * kDensityBlockSize + y) * kDensityBlockSize;
+            // Kept rolled: GCC otherwise unrolls the 16 iterations into
+            // scalar branches before the vectorizer sees the loop
+#pragma GCC unroll 1
+            for (int v = 0; v < kDensityBlockSize; ++v) {
+                row[v] += dx_sq[v] <= limit_sq ? weight * falloff_x[v] : 0.0f;
+            }
+        }
+    }
+}
+
+AME_SIMD_CLONES
+float evaluateAnisotropicDensity(
+    const IsotropicKernelData& centers, const GaussianAttributeTable& shape, float cutoff_sigmas,
+    float px, float py, float pz
+) {
+    using P = GaussianAttributeTable::PackedIndex;
+    const float* x = centers.x.data();
+    const float* y = centers.y.data();
+    const float* z = centers.z.data();
+    const float* opacity = centers.opacity.data();
+    const float* ixx = shape.getInverseCovariance(P::XX).data();
+    const float* ixy = shape.getInverseCovariance(P::XY).data();
+    const float* ixz = shape.getInverseCovariance(P::XZ).data();
+    const float* iyy = shape.getInverseCovariance(P::YY).data();
+    const float* iyz = shape.getInverseCovariance(P::YZ).data();
+    const float* izz = shape.getInverseCovariance(P::ZZ).data();
+    const float cutoff_sq = cutoff_sigmas * cutoff_sigmas;
+    const size_t count = std::min(centers.size(), shape.size());
+    
+    auto term = [&](size_t i) {
+        float dx = px - x[i], dy = py - y[i], dz = pz - z[i];
+        float q = ixx[i] * dx * dx + iyy[i] * dy * dy + izz[i] * dz * dz +
+                  2.0f * (ixy[i] * dx * dy + ixz[i] * dx * dz + iyz[i] * dy * dz);
+        float value = opacity[i] * fastExp(-0.5f * q);
+        return q <= cutoff_sq ? value : 0.0f;
+    };
+    
+    float lanes[kLanes] = {};
+    size_t i = 0;
+    for (; i + kLanes <= count; i += kLanes) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            lanes[l] += term(i + l);
+        }
+    }
+    for (size_t l = 0; i < count; ++i, ++l) {
+        lanes[l] += term(i);
+    }
+    return sumLanes(lanes);
+}
+
+AME_SIMD_CLONES
+void accumulateAnisotropicBlockDensity(
+    const IsotropicKernelData& centers, const GaussianAttributeTable& shape, size_t index, float cutoff_sigmas,
+    const float origin[3], float spacing,
+    int y_lo, int y_hi, int z_lo, int z_hi,
+    float* block
+) {
+    using P = GaussianAttributeTable::PackedIndex;
+    const float cx = centers.x[index], cy = centers.y[index], cz = centers.z[index];
+    const float opacity = centers.opacity[index];
+    const float ixx = shape.getInverseCovariance(P::XX)[index];
+    const float ixy = shape.getInverseCovariance(P::XY)[index];
+    const float ixz = shape.getInverseCovariance(P::XZ)[index];
+    const float iyy = shape.getInverseCovariance(P::YY)[index];
+    const float iyz = shape.getInverseCovariance(P::YZ)[index];
+    const float izz = shape.getInverseCovariance(P::ZZ)[index];
+    const float cutoff_sq = cutoff_sigmas * cutoff_sigmas;
+    
+    float dx[kDensityBlockSize];
+    float dx_sq[kDensityBlockSize];
+    for (int v = 0; v < kDensityBlockSize; ++v) {
+        dx[v] = origin[0] + v * spacing - cx;
+        dx_sq[v] = dx[v] * dx[v];
+    }
+    
+    // Along a row the quadratic form is ixx * dx^2 + 2 * b * dx + c
+    for (int z = z_lo; z <= z_hi; ++z) {
+        float dz = origin[2] + z * spacing - cz;
+        for (int y = y_lo; y <= y_hi; ++y) {
+            float dy = origin[1] + y * spacing - cy;
+            float b = ixy * dy + ixz * dz;
+            float c = iyy * dy * dy + 2.0f * iyz * dy * dz + izz * dz * dz;
+            
+            // The row misses the ellipsoid if even its closest point is outside
+            if (c - b * b / ixx > cutoff_sq) {
+                continue;
+            }
+            
+            float* row = block + (static_cast<size_t>(z) * kDensityBlockSize + y) * kDensityBlockSize;
+            // Kept rolled so the vectorizer sees it, as in the isotropic kernel
+#pragma GCC unroll 1
+            for (int v = 0; v < kDensityBlockSize; ++v) {
+                float q = ixx * dx_sq[v] + 2.0f * b * dx[v] + c;
+                float value = opacity * fastExp(-0.5f * q);
+                row[v] += q <= cutoff_sq ? value : 0.0f;
+            }
+        }
+    }
+}
+
+} // namespace AmeScanner
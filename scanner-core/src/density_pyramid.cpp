@@ -0,0 +1,105 @@
+#include "density_pyramid.h"
+#include <algorithm>
+
+namespace AmeScanner {
+
+void DensityPyramid::build(
+    std::span<const Eigen::Vector3i> brick_coords,
+    std::span<const float> brick_max,
+    std::span<const float> brick_sum
+) {
+    levels_.clear();
+    if (brick_coords.empty()) {
+        return;
+    }
+    
+    Level base;
+    base.coords.assign(brick_coords.begin(), brick_coords.end());
+    base.max.assign(brick_max.begin(), brick_max.end());
+    base.sum.assign(brick_sum.begin(), brick_sum.end());
+    levels_.push_back(std::move(base));
+    
+    // Halve until a single cell is left; coordinates are non-negative and
+    // below 2^21, so at most 21 levels are added
+    while (levels_.back().coords.size() > 1) {
+        const Level& below = levels_.back();
+        
+        std::vector<std::pair<uint64_t, uint32_t>> keyed(below.coords.size());
+        for (size_t c = 0; c < below.coords.size(); ++c) {
+            Eigen::Vector3i parent = below.coords[c] / 2;
+            uint64_t key = (static_cast<uint64_t>(parent.z()) << 42) |
+                           (static_cast<uint64_t>(parent.y()) << 21) |
+                           static_cast<uint64_t>(parent.x());
+            keyed[c] = {key, static_cast<uint32_t>(c)};
+        }
+        std::sort(keyed.begin(), keyed.end());
+        
+        Level level;
+        for (size_t k = 0; k < keyed.size(); ++k) {
+            uint32_t child = keyed[k].second;
+            if (k == 0 || keyed[k].first != keyed[k - 1].first) {
+                level.coords.push_back(below.coords[child] / 2);
+                level.max.push_back(below.max[child]);
+                level.sum.push_back(0.0f);
+                level.child_offsets.push_back(static_cast<uint32_t>(k));
+            }
+            level.max.back() = std::max(level.max.back(), below.max[child]);
+            level.sum.back() += below.sum[child];
+            level.children.push_back(child);
+        }
+        level.child_offsets.push_back(static_cast<uint32_t>(keyed.size()));
+        levels_.push_back(std::move(level));
+    }
+}
+
+float DensityPyramid::getMax() const {
+    if (levels_.empty()) {
+        return 0.0f;
+    }
+    return *std::max_element(levels_.back().max.begin(), levels_.back().max.end());
+}
+
+double DensityPyramid::getSum() const {
+    double sum = 0.0;
+    if (!levels_.empty()) {
+        for (float cell_sum : levels_.back().sum) {
+            sum += cell_sum;
+        }
+    }
+    return sum;
+}
+
+void DensityPyramid::collectBricks(float threshold, std::vector<uint32_t>& bricks) const {
+    bricks.clear();
+    if (levels_.empty()) {
+        return;
+    }
+    
+    std::vector<std::pair<uint32_t, uint32_t>> stack;  // (level, cell)
+    const uint32_t top = static_cast<uint32_t>(levels_.size() - 1);
+    for (uint32_t c = 0; c < levels_[top].coords.size(); ++c) {
+        if (levels_[top].max[c] >= threshold) {
+            stack.emplace_back(top, c);
+        }
+    }
+    
+    while (!stack.empty()) {
+        auto [level, cell] = stack.back();
+        stack.pop_back();
+        if (level == 0) {
+            bricks.push_back(cell);
+            continue;
+        }
+        const Level& current = levels_[level];
+        const Level& below = levels_[level - 1];
+        for (uint32_t k = current.child_offsets[cell]; k < current.child_offsets[cell + 1]; ++k) {
+            uint32_t child = current.children[k];
+            if (below.max[child] >= threshold) {
+                stack.emplace_back(level - 1, child);
+            }
+        }
+    }
+    std::sort(bricks.begin(), bricks.end());
+}
+
+} // namespace AmeScanner
@@ -0,0 +1,126 @@
+#include "gaussian_attributes.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <Eigen/Geometry>
+
+namespace AmeScanner {
+
+namespace {
+
+// Keeps inverse covariances finite for degenerate (flat or zero) scales
+constexpr float kMinScale = 1e-6f;
+
+} // namespace
+
+void GaussianAttributeTable::build(std::span<const Gaussian> gaussians, float extent_sigmas) {
+    extent_sigmas_ = extent_sigmas;
+    clear();
+    append(gaussians);
+}
+
+void GaussianAttributeTable::build(std::span<const Gaussian> gaussians, std::span<const uint32_t> selection, float extent_sigmas) {
+    extent_sigmas_ = extent_sigmas;
+    clear();
+    append(gaussians, selection);
+}
+
+void GaussianAttributeTable::append(std::span<const Gaussian> gaussians) {
+    const size_t first = size();
+    resize(first + gaussians.size());
+    
+    ThreadPool::global().parallelFor(gaussians.size(), 4096, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            fillRow(first + i, gaussians[i]);
+        }
+    });
+    
+    for (size_t row = first; row < size(); ++row) {
+        max_bounding_radius_ = std::max(max_bounding_radius_, bounding_radius_[row]);
+    }
+}
+
+void GaussianAttributeTable::append(std::span<const Gaussian> gaussians, std::span<const uint32_t> selection) {
+    const size_t first = size();
+    resize(first + selection.size());
+    
+    ThreadPool::global().parallelFor(selection.size(), 4096, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            fillRow(first + i, gaussians[selection[i]]);
+        }
+    });
+    
+    for (size_t row = first; row < size(); ++row) {
+        max_bounding_radius_ = std::max(max_bounding_radius_, bounding_radius_[row]);
+    }
+}
+
+void GaussianAttributeTable::clear() {
+    for (int k = 0; k < 6; ++k) {
+        covariance_[k].clear();
+        inverse_covariance_[k].clear();
+    }
+    bounding_radius_.clear();
+    extent_x_.clear();
+    extent_y_.clear();
+    extent_z_.clear();
+    max_bounding_radius_ = 0.0f;
+}
+
+void GaussianAttributeTable::resize(size_t rows) {
+    for (int k = 0; k < 6; ++k) {
+        covariance_[k].resize(rows);
+        inverse_covariance_[k].resize(rows);
+    }
+    bounding_radius_.resize(rows);
+    extent_x_.resize(rows);
+    extent_y_.resize(rows);
+    extent_z_.resize(rows);
+}
+
+void GaussianAttributeTable::fillRow(size_t row, const Gaussian& gaussian) {
+    // Sigma = R diag(s^2) R^T and Sigma^-1 = R diag(1/s^2) R^T
+    Eigen::Vector3f scale = gaussian.getScale().cwiseAbs().cwiseMax(kMinScale);
+    Eigen::Vector3f variance = scale.cwiseProduct(scale);
+    Eigen::Matrix3f R = gaussian.getRotation().normalized().toRotationMatrix();
+    Eigen::Matrix3f cov = R * variance.asDiagonal() * R.transpose();
+    Eigen::Matrix3f inv_cov = R * variance.cwiseInverse().asDiagonal() * R.transpose();
+    
+    covariance_[XX][row] = cov(0, 0);
+    covariance_[XY][row] = cov(0, 1);
+    covariance_[XZ][row] = cov(0, 2);
+    covariance_[YY][row] = cov(1, 1);
+    covariance_[YZ][row] = cov(1, 2);
+    covariance_[ZZ][row] = cov(2, 2);
+    
+    inverse_covariance_[XX][row] = inv_cov(0, 0);
+    inverse_covariance_[XY][row] = inv_cov(0, 1);
+    inverse_covariance_[XZ][row] = inv_cov(0, 2);
+    inverse_covariance_[YY][row] = inv_cov(1, 1);
+    inverse_covariance_[YZ][row] = inv_cov(1, 2);
+    inverse_covariance_[ZZ][row] = inv_cov(2, 2);
+    
+    // The ellipsoid's projection on axis i has half-width k*sqrt(Sigma_ii)
+    bounding_radius_[row] = extent_sigmas_ * scale.maxCoeff();
+    extent_x_[row] = extent_sigmas_ * std::sqrt(cov(0, 0));
+    extent_y_[row] = extent_sigmas_ * std::sqrt(cov(1, 1));
+    extent_z_[row] = extent_sigmas_ * std::sqrt(cov(2, 2));
+}
+
+Eigen::Matrix3f GaussianAttributeTable::getCovarianceMatrix(size_t idx) const {
+    Eigen::Matrix3f m;
+    m << covariance_[XX][idx], covariance_[XY][idx], covariance_[XZ][idx],
+         covariance_[XY][idx], covariance_[YY][idx], covariance_[YZ][idx],
+         covariance_[XZ][idx], covariance_[YZ][idx], covariance_[ZZ][idx];
+    return m;
+}
+
+Eigen::Matrix3f GaussianAttributeTable::getInverseCovarianceMatrix(size_t idx) const {
+    Eigen::Matrix3f m;
+    m << inverse_covariance_[XX][idx], inverse_covariance_[XY][idx], inverse_covariance_[XZ][idx],
+         inverse_covariance_[XY][idx], inverse_covariance_[YY][idx], inverse_covariance_[YZ][idx],
+         inverse_covariance_[XZ][idx], inverse_covariance_[YZ][idx], inverse_covariance_[ZZ][idx];
+    return m;
+}
+
+} // namespace AmeScanner
@@ -0,0 +1,235 @@
+#include "mapped_density_field.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace AmeScanner {
+
+namespace {
+
+uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+bool MappedDensityField::write(const std::string& file_path, const Header& header, const SparseDensityField& field) {
+    // Store bricks in key order so readers can binary search the key table
+    const size_t num_bricks = field.getNumBricks();
+    std::vector<uint64_t> keys(num_bricks);
+    for (size_t b = 0; b < num_bricks; ++b) {
+        keys[b] = SparseDensityField::packKey(field.getBrickCoord(b));
+    }
+    std::vector<uint32_t> order(num_bricks);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    
+    Header out = header;
+    std::memcpy(out.magic, kMagic, sizeof(kMagic));
+    out.version = kVersion;
+    out.brick_size = SparseDensityField::kBrickSize;
+    for (int axis = 0; axis < 3; ++axis) {
+        out.min_bounds[axis] = field.getOrigin()[axis];
+        out.dims[axis] = field.getDims()[axis];
+    }
+    out.grid_size = field.getVoxelSize();
+    out.reserved = 0;
+    out.num_bricks = num_bricks;
+    out.keys_offset = sizeof(Header);
+    out.max_offset = out.keys_offset + num_bricks * sizeof(uint64_t);
+    out.sum_offset = out.max_offset + num_bricks * sizeof(float);
+    out.values_offset = alignUp(out.sum_offset + num_bricks * sizeof(float), kPageAlignment);
+    
+    std::vector<uint64_t> sorted_keys(num_bricks);
+    std::vector<float> sorted_max(num_bricks), sorted_sum(num_bricks);
+    for (size_t i = 0; i < num_bricks; ++i) {
+        sorted_keys[i] = keys[order[i]];
+        sorted_max[i] = field.getBrickMax(order[i]);
+        sorted_sum[i] = field.getBrickSum(order[i]);
+    }
+    
+    const std::string temp_path = file_path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open density field file for writing: " << temp_path << std::endl;
+        return false;
+    }
+    
+    file.write(reinterpret_cast<const char*>(&out), sizeof(out));
+    file.write(reinterpret_cast<const char*>(sorted_keys.data()), num_bricks * sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(sorted_max.data()), num_bricks * sizeof(float));
+    file.write(reinterpret_cast<const char*>(sorted_sum.data()), num_bricks * sizeof(float));
+    std::vector<char> padding(out.values_offset - (out.sum_offset + num_bricks * sizeof(float)), 0);
+    file.write(padding.data(), padding.size());
+    for (uint32_t b : order) {
+        file.write(reinterpret_cast<const char*>(field.getBrickValues(b)), SparseDensityField::kBrickVoxels * sizeof(float));
+    }
+    file.close();
+    
+    if (!file) {
+        std::cerr << "Failed to write density field file: " << temp_path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    if (std::rename(temp_path.c_str(), file_path.c_str()) != 0) {
+        std::cerr << "Failed to move density field file into place: " << file_path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+MappedDensityField::~MappedDensityField() {
+    close();
+}
+
+MappedDensityField::MappedDensityField(MappedDensityField&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedDensityField& MappedDensityField::operator=(MappedDensityField&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(header_, other.header_);
+        std::swap(keys_, other.keys_);
+        std::swap(max_, other.max_);
+        std::swap(sum_, other.sum_);
+        std::swap(values_, other.values_);
+    }
+    return *this;
+}
+
+bool MappedDensityField::open(const std::string& file_path) {
+    close();
+    
+    int fd = ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Failed to open density field file: " << file_path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+        std::cerr << "Density field file is truncated: " << file_path << std::endl;
+        ::close(fd);
+        return false;
+    }
+    
+    // The mapping keeps the file alive after the descriptor is closed
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        std::cerr << "Failed to map density field file: " << file_path << std::endl;
+        return false;
+    }
+    data_ = data;
+    size_ = info.st_size;
+    header_ = static_cast<const Header*>(data_);
+    
+    if (!validate(file_path)) {
+        close();
+        return false;
+    }
+    
+    const char* base = static_cast<const char*>(data_);
+    const size_t num_bricks = header_->num_bricks;
+    keys_ = {reinterpret_cast<const uint64_t*>(base + header_->keys_offset), num_bricks};
+    max_ = {reinterpret_cast<const float*>(base + header_->max_offset), num_bricks};
+    sum_ = {reinterpret_cast<const float*>(base + header_->sum_offset), num_bricks};
+    values_ = {reinterpret_cast<const float*>(base + header_->values_offset), num_bricks * SparseDensityField::kBrickVoxels};
+    return true;
+}
+
+void MappedDensityField::close() {
+    if (data_) {
+        munmap(data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+    keys_ = {};
+    max_ = {};
+    sum_ = {};
+    values_ = {};
+}
+
+int64_t MappedDensityField::findBrick(const Eigen::Vector3i& brick_coord) const {
+    if ((brick_coord.array() < 0).any()) {
+        return SparseDensityField::kNoBrick;
+    }
+    uint64_t key = SparseDensityField::packKey(brick_coord);
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || *it != key) {
+        return SparseDensityField::kNoBrick;
+    }
+    return it - keys_.begin();
+}
+
+float MappedDensityField::getValue(const Eigen::Vector3i& voxel) const {
+    constexpr int kBrickSize = SparseDensityField::kBrickSize;
+    if ((voxel.array() < 0).any()) {
+        return 0.0f;
+    }
+    int64_t brick = findBrick(voxel / kBrickSize);
+    if (brick == SparseDensityField::kNoBrick) {
+        return 0.0f;
+    }
+    Eigen::Vector3i local = voxel - (voxel / kBrickSize) * kBrickSize;
+    return getBrickValues(static_cast<size_t>(brick))[(local.z() * kBrickSize + local.y()) * kBrickSize + local.x()];
+}
+
+void MappedDensityField::collectBricks(float threshold, std::vector<uint32_t>& bricks) const {
+    bricks.clear();
+    for (size_t b = 0; b < max_.size(); ++b) {
+        if (max_[b] >= threshold) {
+            bricks.push_back(static_cast<uint32_t>(b));
+        }
+    }
+}
+
+void MappedDensityField::copyTo(SparseDensityField& field) const {
+    field.reset(getMinBounds(), getGridSize(), getDims());
+    field.reserve(getNumBricks());
+    for (size_t b = 0; b < getNumBricks(); ++b) {
+        field.addBrick(getBrickCoord(b), getBrickValues(b));
+    }
+    field.buildPyramid();
+}
+
+bool MappedDensityField::validate(const std::string& file_path) const {
+    const Header& header = *header_;
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+        std::cerr << "Not a density field file: " << file_path << std::endl;
+        return false;
+    }
+    if (header.version != kVersion || header.brick_size != SparseDensityField::kBrickSize) {
+        std::cerr << "Unsupported density field file version " << header.version
+                  << " (brick size " << header.brick_size << "): " << file_path << std::endl;
+        return false;
+    }
+    
+    // Every section must lie inside the file at its element alignment
+    const uint64_t n = header.num_bricks;
+    auto fits = [&](uint64_t offset, uint64_t element_size, uint64_t count) {
+        return offset % element_size == 0 && offset <= size_ && count <= (size_ - offset) / element_size;
+    };
+    if (n > size_ ||
+        !fits(header.keys_offset, sizeof(uint64_t), n) ||
+        !fits(header.max_offset, sizeof(float), n) ||
+        !fits(header.sum_offset, sizeof(float), n) ||
+        !fits(header.values_offset, SparseDensityField::kBrickVoxels * sizeof(float), n)) {
+        std::cerr << "Density field file is truncated or corrupt: " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace AmeScanner
@@ -0,0 +1,269 @@
+#include "obb_kernels.h"
+#include "simd_dispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace AmeScanner {
+
+namespace {
+
+constexpr int kLanes = kOBBBatchSize;
+
+// Cross-product axes of nearly parallel edges are skipped; the face axes
+// already cover those configurations
+constexpr float kParallelCrossLength2 = 1e-8f;
+
+// Signs of the box extents at each of the 8 corners
+constexpr float kCornerSign[8][3] = {
+    {-1, -1, -1}, {1, -1, -1}, {-1, 1, -1}, {1, 1, -1},
+    {-1, -1, 1}, {1, -1, 1}, {-1, 1, 1}, {1, 1, 1}
+};
+
+// Load one batch of boxes; padding lanes hold empty boxes at the origin
+inline void loadBatch(const float* const columns[kOBBColumns], size_t base, int lanes, float (&box)[kOBBColumns][kLanes]) {
+    for (int c = 0; c < kOBBColumns; ++c) {
+        for (int lane = 0; lane < kLanes; ++lane) {
+            box[c][lane] = lane < lanes ? columns[c][base + lane] : 0.0f;
+        }
+    }
+}
+
+// Squared distance between the segments p1-q1 and p2-q2 of every lane,
+// kept in best2 when shorter. Closest points of the two lines, then t
+// clamped to the segment and s recomputed from it, which gives the exact
+// closest pair of the segments without branches.
+inline void segmentDistance2(
+    const float (&p1)[3][kLanes],
+    const float (&q1)[3][kLanes],
+    const float (&p2)[3][kLanes],
+    const float (&q2)[3][kLanes],
+    float (&best2)[kLanes]
+) {
+#pragma GCC unroll 1
+    for (int lane = 0; lane < kLanes; ++lane) {
+        float d1[3], d2[3], r[3];
+        #pragma GCC unroll 3
+        for (int i = 0; i < 3; ++i) {
+            d1[i] = q1[i][lane] - p1[i][lane];
+            d2[i] = q2[i][lane] - p2[i][lane];
+            r[i] = p1[i][lane] - p2[i][lane];
+        }
+        const float a = d1[0] * d1[0] + d1[1] * d1[1] + d1[2] * d1[2];
+        const float e = d2[0] * d2[0] + d2[1] * d2[1] + d2[2] * d2[2];
+        const float b = d1[0] * d2[0] + d1[1] * d2[1] + d1[2] * d2[2];
+        const float c = d1[0] * r[0] + d1[1] * r[1] + d1[2] * r[2];
+        const float f = d2[0] * r[0] + d2[1] * r[1] + d2[2] * r[2];
+        const float denom = a * e - b * b;
+        const float tiny = std::numeric_limits<float>::min();
+        
+        // Parallel segments leave s0 arbitrary, which the two clamped
+        // steps below still resolve exactly
+        const float s0 = std::min(std::max((b * f - c * e) / std::max(denom, tiny), 0.0f), 1.0f);
+        const float t = std::min(std::max((b * s0 + f) / std::max(e, tiny), 0.0f), 1.0f);
+        const float s = std::min(std::max((b * t - c) / std::max(a, tiny), 0.0f), 1.0f);
+        float dist2 = 0.0f;
+        #pragma GCC unroll 3
+        for (int i = 0; i < 3; ++i) {
+            const float diff = r[i] + d1[i] * s - d2[i] * t;
+            dist2 += diff * diff;
+        }
+        best2[lane] = std::min(best2[lane], dist2);
+    }
+}
+
+} // namespace
+
+AME_SIMD_CLONES
+void computeOBBPairs(
+    size_t count,
+    const float* const a[kOBBColumns],
+    const float* const b[kOBBColumns],
+    float* separation,
+    float* distance,
+    uint8_t* a_contains_b,
+    uint8_t* b_contains_a
+) {
+    for (size_t base = 0; base < count; base += kLanes) {
+        const int lanes = static_cast<int>(std::min<size_t>(kLanes, count - base));
+        float box_a[kOBBColumns][kLanes];
+        float box_b[kOBBColumns][kLanes];
+        loadBatch(a, base, lanes, box_a);
+        loadBatch(b, base, lanes, box_b);
+        
+        float gap[kLanes];
+        float frame_rot[9][kLanes], frame_t[3][kLanes], frame_tb[3][kLanes];
+        int contains_ab[kLanes];
+        int contains_ba[kLanes];
+        
+        // Separating axes and containment in A's frame, with R = A^T B and
+        // t = A^T (center_b - center_a)
+#pragma GCC unroll 1
+        for (int lane = 0; lane < kLanes; ++lane) {
+            float d[3], t[3], tb[3], ea[3], eb[3];
+            float rot[3][3], abs_rot[3][3];
+            #pragma GCC unroll 3
+            for (int r = 0; r < 3; ++r) {
+                d[r] = box_b[kOBBCenter + r][lane] - box_a[kOBBCenter + r][lane];
+                ea[r] = box_a[kOBBExtents + r][lane];
+                eb[r] = box_b[kOBBExtents + r][lane];
+            }
+            #pragma GCC unroll 3
+            for (int i = 0; i < 3; ++i) {
+                t[i] = 0.0f;
+                #pragma GCC unroll 3
+                for (int r = 0; r < 3; ++r) {
+                    t[i] += box_a[kOBBAxes + 3 * i + r][lane] * d[r];
+                }
+                #pragma GCC unroll 3
+                for (int j = 0; j < 3; ++j) {
+                    float dot = 0.0f;
+                    #pragma GCC unroll 3
+                    for (int r = 0; r < 3; ++r) {
+                        dot += box_a[kOBBAxes + 3 * i + r][lane] * box_b[kOBBAxes + 3 * j + r][lane];
+                    }
+                    rot[i][j] = dot;
+                    abs_rot[i][j] = std::abs(dot);
+                }
+            }
+            
+            // Face axes of A, then of B (t in B's frame is R^T t)
+            float best = -std::numeric_limits<float>::max();
+            int inside_a = 1, inside_b = 1;
+            #pragma GCC unroll 3
+            for (int i = 0; i < 3; ++i) {
+                float radius_b = 0.0f;
+                #pragma GCC unroll 3
+                for (int j = 0; j < 3; ++j) {
+                    radius_b += eb[j] * abs_rot[i][j];
+                }
+                best = std::max(best, std::abs(t[i]) - ea[i] - radius_b);
+                inside_a &= std::abs(t[i]) + radius_b <= ea[i];
+            }
+            #pragma GCC unroll 3
+            for (int j = 0; j < 3; ++j) {
+                tb[j] = 0.0f;
+                float radius_a = 0.0f;
+                #pragma GCC unroll 3
+                for (int i = 0; i < 3; ++i) {
+                    tb[j] += t[i] * rot[i][j];
+                    radius_a += ea[i] * abs_rot[i][j];
+                }
+                best = std::max(best, std::abs(tb[j]) - eb[j] - radius_a);
+                inside_b &= std::abs(tb[j]) + radius_a <= eb[j];
+            }
+            
+            // Edge cross products A_i x B_j, normalized by their length
+            #pragma GCC unroll 3
+            for (int i = 0; i < 3; ++i) {
+                const int i1 = (i + 1) % 3, i2 = (i + 2) % 3;
+                #pragma GCC unroll 3
+                for (int j = 0; j < 3; ++j) {
+                    const int j1 = (j + 1) % 3, j2 = (j + 2) % 3;
+                    const float radius_a = ea[i1] * abs_rot[i2][j] + ea[i2] * abs_rot[i1][j];
+                    const float radius_b = eb[j1] * abs_rot[i][j2] + eb[j2] * abs_rot[i][j1];
+                    const float projected = std::abs(t[i2] * rot[i1][j] - t[i1] * rot[i2][j]);
+                    const float length2 = 1.0f - rot[i][j] * rot[i][j];
+                    const float axis_gap = (projected - radius_a - radius_b) / std::sqrt(std::max(length2, kParallelCrossLength2));
+                    const float skip = length2 > kParallelCrossLength2 ? 0.0f : -std::numeric_limits<float>::max();
+                    best = std::max(best, axis_gap + skip);
+                }
+            }
+            
+            gap[lane] = best;
+            #pragma GCC unroll 3
+            for (int i = 0; i < 3; ++i) {
+                frame_t[i][lane] = t[i];
+                frame_tb[i][lane] = tb[i];
+                #pragma GCC unroll 3
+                for (int j = 0; j < 3; ++j) {
+                    frame_rot[3 * i + j][lane] = rot[i][j];
+                }
+            }
+            contains_ab[lane] = inside_a;
+            contains_ba[lane] = inside_b;
+        }
+        
+        for (int lane = 0; lane < lanes; ++lane) {
+            if (separation) {
+                separation[base + lane] = gap[lane];
+            }
+            if (a_contains_b) {
+                a_contains_b[base + lane] = static_cast<uint8_t>(contains_ab[lane]);
+            }
+            if (b_contains_a) {
+                b_contains_a[base + lane] = static_cast<uint8_t>(contains_ba[lane]);
+            }
+        }
+        if (!distance) {
+            continue;
+        }
+        
+        // Disjoint boxes are closest at a corner against the other box or
+        // between two edges; all 16 corners and 144 edge pairs are tried.
+        // Batches of intersecting pairs are all at distance 0.
+        int num_disjoint = 0;
+        for (int lane = 0; lane < lanes; ++lane) {
+            num_disjoint += gap[lane] > 0.0f;
+        }
+        if (num_disjoint == 0) {
+            for (int lane = 0; lane < lanes; ++lane) {
+                distance[base + lane] = 0.0f;
+            }
+            continue;
+        }
+        
+        float corner_a[8][3][kLanes], corner_b[8][3][kLanes], best2[kLanes];
+#pragma GCC unroll 1
+        for (int lane = 0; lane < kLanes; ++lane) {
+            float ea[3], eb[3];
+            #pragma GCC unroll 3
+            for (int i = 0; i < 3; ++i) {
+                ea[i] = box_a[kOBBExtents + i][lane];
+                eb[i] = box_b[kOBBExtents + i][lane];
+            }
+            float dist2 = std::numeric_limits<float>::max();
+            #pragma GCC unroll 8
+            for (int v = 0; v < 8; ++v) {
+                // Corners v of both boxes in A's frame, and corner v of A in B's frame
+                float from_b = 0.0f, from_a = 0.0f;
+                #pragma GCC unroll 3
+                for (int i = 0; i < 3; ++i) {
+                    float in_a = frame_t[i][lane], in_b = -frame_tb[i][lane];
+                    #pragma GCC unroll 3
+                    for (int j = 0; j < 3; ++j) {
+                        in_a += frame_rot[3 * i + j][lane] * kCornerSign[v][j] * eb[j];
+                        in_b += frame_rot[3 * j + i][lane] * kCornerSign[v][j] * ea[j];
+                    }
+                    corner_a[v][i][lane] = kCornerSign[v][i] * ea[i];
+                    corner_b[v][i][lane] = in_a;
+                    const float outside_a = std::max(std::abs(in_a) - ea[i], 0.0f);
+                    const float outside_b = std::max(std::abs(in_b) - eb[i], 0.0f);
+                    from_b += outside_a * outside_a;
+                    from_a += outside_b * outside_b;
+                }
+                dist2 = std::min(dist2, std::min(from_a, from_b));
+            }
+            best2[lane] = dist2;
+        }
+        for (int u = 0; u < 8; ++u) {
+            for (int k = 0; k < 3; ++k) {
+                if (u >> k & 1) {
+                    continue;
+                }
+                for (int v = 0; v < 8; ++v) {
+                    for (int j = 0; j < 3; ++j) {
+                        if (!(v >> j & 1)) {
+                            segmentDistance2(corner_a[u], corner_a[u | 1 << k], corner_b[v], corner_b[v | 1 << j], best2);
+                        }
+                    }
+                }
+            }
+        }
+        for (int lane = 0; lane < lanes; ++lane) {
+            distance[base + lane] = gap[lane] <= 0.0f ? 0.0f : std::sqrt(best2[lane]);
+        }
+    }
+}
+
+} // namespace AmeScanner
@@ -0,0 +1,106 @@
+#include "sparse_density_field.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace AmeScanner {
+
+void SparseDensityField::reset(const Eigen::Vector3f& origin, float voxel_size, const Eigen::Vector3i& dims) {
+    origin_ = origin;
+    voxel_size_ = voxel_size;
+    dims_ = dims;
+    brick_coords_.clear();
+    values_.clear();
+    brick_max_.clear();
+    brick_sum_.clear();
+    lookup_.clear();
+    pyramid_.clear();
+}
+
+void SparseDensityField::reserve(size_t num_bricks) {
+    brick_coords_.reserve(num_bricks);
+    values_.reserve(num_bricks * kBrickVoxels);
+    brick_max_.reserve(num_bricks);
+    brick_sum_.reserve(num_bricks);
+    lookup_.reserve(num_bricks);
+}
+
+size_t SparseDensityField::addBrick(const Eigen::Vector3i& brick_coord, const float* values) {
+    size_t brick = brick_coords_.size();
+    auto inserted = lookup_.emplace(packKey(brick_coord), static_cast<uint32_t>(brick));
+    if (!inserted.second) {
+        std::cerr << "Brick (" << brick_coord.transpose() << ") added twice" << std::endl;
+        return inserted.first->second;
+    }
+    
+    brick_coords_.push_back(brick_coord);
+    values_.insert(values_.end(), values, values + kBrickVoxels);
+    brick_max_.push_back(*std::max_element(values, values + kBrickVoxels));
+    brick_sum_.push_back(std::accumulate(values, values + kBrickVoxels, 0.0f));
+    pyramid_.clear();
+    return brick;
+}
+
+int64_t SparseDensityField::findBrick(const Eigen::Vector3i& brick_coord) const {
+    if ((brick_coord.array() < 0).any()) {
+        return kNoBrick;
+    }
+    auto it = lookup_.find(packKey(brick_coord));
+    return it == lookup_.end() ? kNoBrick : static_cast<int64_t>(it->second);
+}
+
+float SparseDensityField::getValue(const Eigen::Vector3i& voxel) const {
+    if ((voxel.array() < 0).any()) {
+        return 0.0f;
+    }
+    int64_t brick = findBrick(voxel / kBrickSize);
+    if (brick == kNoBrick) {
+        return 0.0f;
+    }
+    Eigen::Vector3i local = voxel - (voxel / kBrickSize) * kBrickSize;
+    return getBrickValues(static_cast<size_t>(brick))[(local.z() * kBrickSize + local.y()) * kBrickSize + local.x()];
+}
+
+void SparseDensityField::buildPyramid() {
+    pyramid_.build(brick_coords_, brick_max_, brick_sum_);
+}
+
+void SparseDensityField::collectBricks(float threshold, std::vector<uint32_t>& bricks) const {
+    if (!pyramid_.empty()) {
+        pyramid_.collectBricks(threshold, bricks);
+        return;
+    }
+    bricks.clear();
+    for (size_t b = 0; b < brick_max_.size(); ++b) {
+        if (brick_max_[b] >= threshold) {
+            bricks.push_back(static_cast<uint32_t>(b));
+        }
+    }
+}
+
+size_t SparseDensityField::getMemoryUsage() const {
+    return values_.capacity() * sizeof(float) +
+           (brick_max_.capacity() + brick_sum_.capacity()) * sizeof(float) +
+           brick_coords_.capacity() * sizeof(Eigen::Vector3i) +
+           lookup_.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void*)) +
+           lookup_.bucket_count() * sizeof(void*);
+}
+
+uint64_t SparseDensityField::packKey(const Eigen::Vector3i& brick_coord) {
+    // Brick coordinates are non-negative and below 2^21
+    constexpr uint64_t kMask = (uint64_t(1) << 21) - 1;
+    return ((static_cast<uint64_t>(brick_coord.x()) & kMask) << 42) |
+           ((static_cast<uint64_t>(brick_coord.y()) & kMask) << 21) |
+           (static_cast<uint64_t>(brick_coord.z()) & kMask);
+}
+
+Eigen::Vector3i SparseDensityField::unpackKey(uint64_t key) {
+    constexpr uint64_t kMask = (uint64_t(1) << 21) - 1;
+    return Eigen::Vector3i(
+        static_cast<int>((key >> 42) & kMask),
+        static_cast<int>((key >> 21) & kMask),
+        static_cast<int>(key & kMask)
+    );
+}
+
+} // namespace AmeScanner
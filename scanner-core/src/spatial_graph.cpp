@@ -1,115 +1,523 @@
 #include "spatial_graph.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <chrono>
 #include <fstream>
+#include <algorithm>
+#include <limits>
 
 namespace AmeScanner {
 
 void SpatialGraph::buildGraph(const std::vector<AmeEntity>& entities) {
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    relationships_.clear();
+    stats_ = Statistics();
     
     size_t n = entities.size();
+    entity_ids_.resize(n);
     for (size_t i = 0; i < n; ++i) {
-        for (size_t j = 0; j < n; ++j) {
-            if (i == j) {
-                continue;
+        entity_ids_[i] = entities[i].id;
+    }
+    row_offsets_.assign(n + 1, 0);
+    type_masks_.assign(n, 0);
+    
+    std::vector<Eigen::AlignedBox3f> bounds(n);
+    for (size_t i = 0; i < n; ++i) {
+        bounds[i] = computeBounds(entities[i].obb);
+    }
+    bvh_.build(bounds);
+    
+    // Sources are split into fixed ranges, each evaluated into its own
+    // edge buffer, so the rows never depend on how tasks meet threads
+    auto& pool = ThreadPool::global();
+    scratch_.resize(pool.getNumThreads());
+    const size_t num_tasks = (n + kSourcesPerTask - 1) / kSourcesPerTask;
+    std::vector<EdgeBuffer> buffers(num_tasks);
+    std::vector<size_t> task_candidates(num_tasks, 0);
+    pool.parallelFor(num_tasks, 1, [&](size_t begin, size_t end, size_t worker_id) {
+        auto& scratch = scratch_[worker_id];
+        for (size_t task = begin; task < end; ++task) {
+            auto& edges = buffers[task];
+            const size_t last = std::min(n, (task + 1) * kSourcesPerTask);
+            for (size_t i = task * kSourcesPerTask; i < last; ++i) {
+                const size_t first = edges.targets.size();
+                task_candidates[task] += evaluateRow(entities, static_cast<uint32_t>(i), scratch, edges);
+                for (size_t e = first; e < edges.targets.size(); ++e) {
+                    type_masks_[i] |= static_cast<uint16_t>(1u << static_cast<int>(edges.types[e]));
+                }
+                row_offsets_[i + 1] = static_cast<uint32_t>(edges.targets.size() - first);
             }
+        }
+    });
+    
+    // Prefix sum of the row lengths places every buffer in the CSR arrays
+    for (size_t i = 0; i < n; ++i) {
+        row_offsets_[i + 1] += row_offsets_[i];
+    }
+    targets_.resize(row_offsets_[n]);
+    types_.resize(row_offsets_[n]);
+    pool.parallelFor(num_tasks, 1, [&](size_t begin, size_t end, size_t) {
+        for (size_t task = begin; task < end; ++task) {
+            const uint32_t offset = row_offsets_[task * kSourcesPerTask];
+            std::copy(buffers[task].targets.begin(), buffers[task].targets.end(), targets_.begin() + offset);
+            std::copy(buffers[task].types.begin(), buffers[task].types.end(), types_.begin() + offset);
+        }
+    });
+    for (size_t candidates : task_candidates) {
+        stats_.num_candidate_pairs += candidates;
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    stats_.num_relationships = targets_.size();
+    computeGraphBytes();
+    stats_.build_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    
+    std::cout << "Spatial graph built in " << stats_.build_time_ms << " ms" << std::endl;
+    std::cout << "Found " << targets_.size() << " spatial relationships from "
+              << stats_.num_candidate_pairs << " candidate pairs" << std::endl;
+}
+
+size_t SpatialGraph::evaluateRow(const std::vector<AmeEntity>& entities, uint32_t source, RowScratch& scratch, EdgeBuffer& edges) {
+    // Containment and adjacency need overlapping or nearly touching boxes,
+    // directional relations centers within the cutoff; one padded query
+    // covers both
+    const float padding = std::max(kAdjacencyDistance, directional_cutoff_);
+    const Eigen::AlignedBox3f& bounds = bvh_.getBox(source);
+    Eigen::AlignedBox3f query(bounds.min().array() - padding, bounds.max().array() + padding);
+    auto& candidates = scratch.candidates;
+    candidates.clear();
+    bvh_.forEachOverlap(query, [&](uint32_t j) {
+        if (j != source) {
+            candidates.push_back(j);
+        }
+    });
+    std::sort(candidates.begin(), candidates.end());
+    
+    // Exact geometry of all candidate pairs in one kernel call
+    const size_t count = candidates.size();
+    float* columns[2][kOBBColumns];
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < kOBBColumns; ++c) {
+            scratch.columns[side][c].resize(count);
+            columns[side][c] = scratch.columns[side][c].data();
+        }
+    }
+    for (size_t k = 0; k < count; ++k) {
+        packOBB(entities[source].obb, columns[0], k);
+        packOBB(entities[candidates[k]].obb, columns[1], k);
+    }
+    scratch.distances.resize(count);
+    scratch.contains.resize(count);
+    scratch.contained.resize(count);
+    measurePairs(count, scratch, scratch.distances.data(), scratch.contains.data(), scratch.contained.data());
+    
+    const size_t first = edges.targets.size();
+    for (size_t k = 0; k < count; ++k) {
+        const uint32_t j = candidates[k];
+        PairGeometry geometry;
+        geometry.contains = scratch.contains[k];
+        geometry.contained_by = scratch.contained[k];
+        geometry.distance = scratch.distances[k];
+        RelationshipType type = classifyRelationship(entities[source], entities[j], geometry);
+        if (type == RelationshipType::None) {
+            continue;
+        }
+        if (isDirectional(type) && (entities[source].obb.center - entities[j].obb.center).norm() > directional_cutoff_) {
+            continue;
+        }
+        edges.targets.push_back(j);
+        edges.types.push_back(type);
+    }
+    keepNearestDirectional(entities, source, first, scratch, edges);
+    return count;
+}
+
+void SpatialGraph::measurePairs(size_t count, RowScratch& scratch, float* distances, uint8_t* contains, uint8_t* contained) {
+    float* columns[2][kOBBColumns];
+    float* near_columns[2][kOBBColumns];
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < kOBBColumns; ++c) {
+            columns[side][c] = scratch.columns[side][c].data();
+        }
+    }
+    scratch.separations.resize(count);
+    computeOBBPairs(count, columns[0], columns[1], scratch.separations.data(), nullptr, contains, contained);
+    
+    // Only the adjacency test needs the exact distance, and the separating
+    // gap already rules it out for most pairs; the rest get the gap, a
+    // lower bound
+    scratch.near.clear();
+    for (size_t k = 0; k < count; ++k) {
+        const float separation = scratch.separations[k];
+        distances[k] = std::max(separation, 0.0f);
+        if (separation > 0.0f && separation < kAdjacencyDistance) {
+            scratch.near.push_back(static_cast<uint32_t>(k));
+        }
+    }
+    const size_t num_near = scratch.near.size();
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < kOBBColumns; ++c) {
+            scratch.near_columns[side][c].resize(num_near);
+            near_columns[side][c] = scratch.near_columns[side][c].data();
+            for (size_t m = 0; m < num_near; ++m) {
+                near_columns[side][c][m] = columns[side][c][scratch.near[m]];
+            }
+        }
+    }
+    scratch.separations.resize(num_near);
+    computeOBBPairs(num_near, near_columns[0], near_columns[1], nullptr, scratch.separations.data(), nullptr, nullptr);
+    for (size_t m = 0; m < num_near; ++m) {
+        distances[scratch.near[m]] = scratch.separations[m];
+    }
+}
+
+void SpatialGraph::keepNearestDirectional(const std::vector<AmeEntity>& entities, uint32_t source, size_t first, RowScratch& scratch, EdgeBuffer& edges) {
+    auto& targets = edges.targets;
+    auto& types = edges.types;
+    auto& directional = scratch.directional;
+    directional.clear();
+    for (size_t e = first; e < targets.size(); ++e) {
+        if (isDirectional(types[e])) {
+            directional.emplace_back((entities[source].obb.center - entities[targets[e]].obb.center).norm(), e);
+        }
+    }
+    if (directional.size() <= max_directional_neighbors_) {
+        return;
+    }
+    
+    // Keep the nearest directional partners, ties to the lower target
+    std::nth_element(directional.begin(), directional.begin() + max_directional_neighbors_, directional.end());
+    std::vector<bool> dropped(targets.size() - first, false);
+    for (size_t k = max_directional_neighbors_; k < directional.size(); ++k) {
+        dropped[directional[k].second - first] = true;
+    }
+    size_t kept = first;
+    for (size_t e = first; e < targets.size(); ++e) {
+        if (!dropped[e - first]) {
+            targets[kept] = targets[e];
+            types[kept] = types[e];
+            ++kept;
+        }
+    }
+    targets.resize(kept);
+    types.resize(kept);
+}
+
+bool SpatialGraph::updateEntities(const std::vector<AmeEntity>& entities, const std::vector<uint32_t>& changed) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    const size_t n = entity_ids_.size();
+    if (row_offsets_.size() != n + 1) {
+        std::cerr << "Spatial graph has not been built" << std::endl;
+        return false;
+    }
+    if (entities.size() != n) {
+        std::cerr << "Entity list has " << entities.size() << " entities, the graph " << n << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> is_changed(n, 0);
+    for (uint32_t c : changed) {
+        if (c >= n || entities[c].id != entity_ids_[c]) {
+            std::cerr << "Changed entity " << c << " is not in the graph" << std::endl;
+            return false;
+        }
+        is_changed[c] = 1;
+    }
+    std::vector<uint32_t> changed_rows;
+    for (uint32_t c = 0; c < n; ++c) {
+        if (is_changed[c]) {
+            changed_rows.push_back(c);
+        }
+    }
+    if (scratch_.empty()) {
+        scratch_.resize(1);
+    }
+    auto& scratch = scratch_[0];
+    
+    // A source row can change only through its pairs with changed
+    // entities. Old partners are found with the old boxes, new ones after
+    // the refit; the discovery query is a little wider than a row's own
+    // query so rounding cannot lose a partner, and the row's own query
+    // box decides which pairs count.
+    const float padding = std::max(kAdjacencyDistance, directional_cutoff_);
+    const float discovery_padding = 1.01f * padding;
+    std::vector<uint8_t> is_partner(n, 0);
+    auto markPartners = [&](uint32_t c) {
+        const Eigen::AlignedBox3f& box = bvh_.getBox(c);
+        bvh_.forEachOverlap(Eigen::AlignedBox3f(box.min().array() - discovery_padding, box.max().array() + discovery_padding), [&](uint32_t s) {
+            if (!is_changed[s]) {
+                is_partner[s] = 1;
+            }
+        });
+    };
+    for (uint32_t c : changed_rows) {
+        markPartners(c);
+    }
+    std::vector<Eigen::AlignedBox3f> new_bounds(changed_rows.size());
+    for (size_t k = 0; k < changed_rows.size(); ++k) {
+        new_bounds[k] = computeBounds(entities[changed_rows[k]].obb);
+    }
+    bvh_.refit(changed_rows, new_bounds);
+    
+    // New (partner, changed) pairs, by partner, then changed entity
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    for (uint32_t c : changed_rows) {
+        markPartners(c);
+        const Eigen::AlignedBox3f& box = bvh_.getBox(c);
+        bvh_.forEachOverlap(Eigen::AlignedBox3f(box.min().array() - discovery_padding, box.max().array() + discovery_padding), [&](uint32_t s) {
+            const Eigen::AlignedBox3f& bounds = bvh_.getBox(s);
+            if (!is_changed[s] && Eigen::AlignedBox3f(bounds.min().array() - padding, bounds.max().array() + padding).intersects(box)) {
+                pairs.emplace_back(s, c);
+            }
+        });
+    }
+    std::sort(pairs.begin(), pairs.end());
+    
+    const size_t count = pairs.size();
+    float* columns[2][kOBBColumns];
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < kOBBColumns; ++c) {
+            scratch.columns[side][c].resize(count);
+            columns[side][c] = scratch.columns[side][c].data();
+        }
+    }
+    for (size_t k = 0; k < count; ++k) {
+        packOBB(entities[pairs[k].first].obb, columns[0], k);
+        packOBB(entities[pairs[k].second].obb, columns[1], k);
+    }
+    // Kept apart from the scratch, which evaluateRow reuses below
+    std::vector<float> pair_distances(count);
+    std::vector<uint8_t> pair_contains(count), pair_contained(count);
+    measurePairs(count, scratch, pair_distances.data(), pair_contains.data(), pair_contained.data());
+    
+    // Rebuild the affected rows in ascending order into one buffer
+    EdgeBuffer edges;
+    std::vector<uint32_t> rows;
+    std::vector<uint32_t> row_ends;
+    size_t next_pair = 0;
+    for (uint32_t s = 0; s < n; ++s) {
+        if (!is_changed[s] && !is_partner[s]) {
+            continue;
+        }
+        const size_t first = edges.targets.size();
+        if (is_changed[s]) {
+            evaluateRow(entities, s, scratch, edges);
+        } else {
+            // Pairs with unchanged targets keep their classification, so
+            // the stored row is patched with the reclassified pairs
+            size_t row_pairs_end = next_pair;
+            while (row_pairs_end < count && pairs[row_pairs_end].first == s) {
+                ++row_pairs_end;
+            }
+            auto& row = scratch.row;
+            row.clear();
+            size_t num_directional = 0;
+            bool loses_directional = false;
+            for (uint32_t e = row_offsets_[s]; e < row_offsets_[s + 1]; ++e) {
+                num_directional += isDirectional(types_[e]);
+                if (!is_changed[targets_[e]]) {
+                    row.emplace_back(targets_[e], types_[e]);
+                } else {
+                    loses_directional = loses_directional || isDirectional(types_[e]);
+                }
+            }
+            for (size_t k = next_pair; k < row_pairs_end; ++k) {
+                const uint32_t c = pairs[k].second;
+                PairGeometry geometry;
+                geometry.contains = pair_contains[k];
+                geometry.contained_by = pair_contained[k];
+                geometry.distance = pair_distances[k];
+                RelationshipType type = classifyRelationship(entities[s], entities[c], geometry);
+                if (type == RelationshipType::None) {
+                    continue;
+                }
+                if (isDirectional(type) && (entities[s].obb.center - entities[c].obb.center).norm() > directional_cutoff_) {
+                    continue;
+                }
+                row.emplace_back(c, type);
+            }
+            next_pair = row_pairs_end;
+            std::sort(row.begin(), row.end());
             
-            SpatialRelationship relationship = computeRelationship(entities[i], entities[j]);
-            if (!relationship.relationship_type.empty()) {
-                relationships_.push_back(relationship);
+            // A full row that loses a directional partner may take back
+            // one it dropped. Only directional or unrelated pairs are ever
+            // missing from a row, so their type follows from the centers.
+            if (num_directional >= max_directional_neighbors_ && loses_directional) {
+                const size_t stored = row.size();
+                const Eigen::AlignedBox3f& bounds = bvh_.getBox(s);
+                bvh_.forEachOverlap(Eigen::AlignedBox3f(bounds.min().array() - padding, bounds.max().array() + padding), [&](uint32_t j) {
+                    if (j == s || is_changed[j] ||
+                        std::binary_search(row.begin(), row.begin() + stored, std::make_pair(j, RelationshipType{}),
+                                           [](const auto& a, const auto& b) { return a.first < b.first; })) {
+                        return;
+                    }
+                    PairGeometry geometry;
+                    geometry.distance = std::numeric_limits<float>::max();
+                    RelationshipType type = classifyRelationship(entities[s], entities[j], geometry);
+                    if (type != RelationshipType::None && (entities[s].obb.center - entities[j].obb.center).norm() <= directional_cutoff_) {
+                        row.emplace_back(j, type);
+                    }
+                });
+                std::sort(row.begin(), row.end());
             }
+            
+            for (const auto& [target, type] : row) {
+                edges.targets.push_back(target);
+                edges.types.push_back(type);
+            }
+            keepNearestDirectional(entities, s, first, scratch, edges);
+        }
+        
+        type_masks_[s] = 0;
+        for (size_t e = first; e < edges.targets.size(); ++e) {
+            type_masks_[s] |= static_cast<uint16_t>(1u << static_cast<int>(edges.types[e]));
         }
+        rows.push_back(s);
+        row_ends.push_back(static_cast<uint32_t>(edges.targets.size()));
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    float duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    // Splice the new rows in; the untouched runs between them move whole
+    std::vector<uint32_t> offsets(n + 1, 0);
+    std::vector<uint32_t> targets;
+    std::vector<RelationshipType> types;
+    targets.reserve(targets_.size() + edges.targets.size());
+    types.reserve(targets_.size() + edges.targets.size());
+    uint32_t next_row = 0;
+    for (size_t r = 0; r <= rows.size(); ++r) {
+        const uint32_t row = r < rows.size() ? rows[r] : static_cast<uint32_t>(n);
+        const int64_t shift = static_cast<int64_t>(targets.size()) - row_offsets_[next_row];
+        targets.insert(targets.end(), targets_.begin() + row_offsets_[next_row], targets_.begin() + row_offsets_[row]);
+        types.insert(types.end(), types_.begin() + row_offsets_[next_row], types_.begin() + row_offsets_[row]);
+        for (uint32_t i = next_row; i < row; ++i) {
+            offsets[i + 1] = static_cast<uint32_t>(row_offsets_[i + 1] + shift);
+        }
+        if (r == rows.size()) {
+            break;
+        }
+        const uint32_t begin = r > 0 ? row_ends[r - 1] : 0;
+        targets.insert(targets.end(), edges.targets.begin() + begin, edges.targets.begin() + row_ends[r]);
+        types.insert(types.end(), edges.types.begin() + begin, edges.types.begin() + row_ends[r]);
+        offsets[row + 1] = static_cast<uint32_t>(targets.size());
+        next_row = row + 1;
+    }
+    row_offsets_.swap(offsets);
+    targets_.swap(targets);
+    types_.swap(types);
     
-    std::cout << "Spatial graph built in " << duration_ms << " ms" << std::endl;
-    std::cout << "Found " << relationships_.size() << " spatial relationships" << std::endl;
+    auto end_time = std::chrono::high_resolution_clock::now();
+    stats_.num_relationships = targets_.size();
+    computeGraphBytes();
+    stats_.num_updated_rows = rows.size();
+    stats_.update_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    return true;
+}
+
+void SpatialGraph::computeGraphBytes() {
+    stats_.graph_bytes = (entity_ids_.size() + row_offsets_.size() + targets_.size()) * sizeof(uint32_t) +
+                         types_.size() * sizeof(RelationshipType) + type_masks_.size() * sizeof(uint16_t);
+}
+
+Eigen::AlignedBox3f SpatialGraph::computeBounds(const OBB& obb) {
+    // Half size along each world axis is |R| * extents
+    Eigen::Vector3f half = obb.rotation.cwiseAbs() * obb.extents;
+    return Eigen::AlignedBox3f(obb.center - half, obb.center + half);
+}
+
+std::vector<SpatialRelationship> SpatialGraph::getRelationships() const {
+    std::vector<SpatialRelationship> relationships;
+    relationships.reserve(targets_.size());
+    for (uint32_t source = 0; source < entity_ids_.size(); ++source) {
+        for (uint32_t e = row_offsets_[source]; e < row_offsets_[source + 1]; ++e) {
+            SpatialRelationship relationship;
+            relationship.source_id = entity_ids_[source];
+            relationship.target_id = entity_ids_[targets_[e]];
+            relationship.relationship_type = types_[e];
+            relationship.confidence = getConfidence(types_[e]);
+            relationships.push_back(relationship);
+        }
+    }
+    return relationships;
+}
+
+const char* SpatialGraph::getRelationshipName(RelationshipType type) {
+    return type == RelationshipType::None ? "none" : kRelationshipNames[static_cast<int>(type)];
+}
+
+float SpatialGraph::getConfidence(RelationshipType type) {
+    switch (type) {
+        case RelationshipType::Contains:
+        case RelationshipType::ContainedBy:
+            return 0.9f;
+        case RelationshipType::AdjacentTo:
+            return 0.8f;
+        case RelationshipType::Above:
+        case RelationshipType::Below:
+            return 0.7f;
+        case RelationshipType::LeftOf:
+        case RelationshipType::RightOf:
+        case RelationshipType::FrontOf:
+        case RelationshipType::Behind:
+            return 0.6f;
+        default:
+            return 0.0f;
+    }
+}
+
+bool SpatialGraph::isDirectional(RelationshipType type) {
+    return type != RelationshipType::Contains && type != RelationshipType::ContainedBy && type != RelationshipType::AdjacentTo;
 }
 
 SpatialRelationship SpatialGraph::computeRelationship(const AmeEntity& entity1, const AmeEntity& entity2) {
     SpatialRelationship relationship;
     relationship.source_id = entity1.id;
     relationship.target_id = entity2.id;
-    relationship.confidence = 0.0f;
-    
+    relationship.relationship_type = classifyRelationship(entity1, entity2, computePairGeometry(entity1.obb, entity2.obb));
+    relationship.confidence = getConfidence(relationship.relationship_type);
+    return relationship;
+}
+
+RelationshipType SpatialGraph::classifyRelationship(const AmeEntity& entity1, const AmeEntity& entity2, const PairGeometry& geometry) {
     // Check containment
-    if (contains(entity1, entity2)) {
-        relationship.relationship_type = "contains";
-        relationship.confidence = 0.9f;
-        return relationship;
+    if (geometry.contains) {
+        return RelationshipType::Contains;
     }
     
-    if (contains(entity2, entity1)) {
-        relationship.relationship_type = "contained_by";
-        relationship.confidence = 0.9f;
-        return relationship;
+    if (geometry.contained_by) {
+        return RelationshipType::ContainedBy;
     }
     
     // Check adjacency
-    if (isAdjacent(entity1, entity2)) {
-        relationship.relationship_type = "adjacent_to";
-        relationship.confidence = 0.8f;
-        return relationship;
+    if (geometry.distance < kAdjacencyDistance) {
+        return RelationshipType::AdjacentTo;
     }
     
     // Check relative positions
     if (isAbove(entity1, entity2)) {
-        relationship.relationship_type = "above";
-        relationship.confidence = 0.7f;
-        return relationship;
+        return RelationshipType::Above;
     }
     
     if (isAbove(entity2, entity1)) {
-        relationship.relationship_type = "below";
-        relationship.confidence = 0.7f;
-        return relationship;
+        return RelationshipType::Below;
     }
     
     if (isLeftOf(entity1, entity2)) {
-        relationship.relationship_type = "left_of";
-        relationship.confidence = 0.6f;
-        return relationship;
+        return RelationshipType::LeftOf;
     }
     
     if (isLeftOf(entity2, entity1)) {
-        relationship.relationship_type = "right_of";
-        relationship.confidence = 0.6f;
-        return relationship;
+        return RelationshipType::RightOf;
     }
     
     if (isFrontOf(entity1, entity2)) {
-        relationship.relationship_type = "front_of";
-        relationship.confidence = 0.6f;
-        return relationship;
+        return RelationshipType::FrontOf;
     }
     
     if (isFrontOf(entity2, entity1)) {
-        relationship.relationship_type = "behind";
-        relationship.confidence = 0.6f;
-        return relationship;
+        return RelationshipType::Behind;
     }
     
     // No significant relationship found
-    return relationship;
-}
-
-bool SpatialGraph::contains(const AmeEntity& container, const AmeEntity& contained) {
-    // Simplified containment check: check if contained OBB center is inside container OBB
-    const OBB& container_obb = container.obb;
-    const OBB& contained_obb = contained.obb;
-    
-    // Transform contained center to container space
-    Eigen::Vector3f relative_center = container_obb.rotation.transpose() * (contained_obb.center - container_obb.center);
-    
-    // Check if relative center is within container extents
-    return (std::abs(relative_center.x()) < container_obb.extents.x()) &&
-           (std::abs(relative_center.y()) < container_obb.extents.y()) &&
-           (std::abs(relative_center.z()) < container_obb.extents.z());
+    return RelationshipType::None;
 }
 
 bool SpatialGraph::isAbove(const AmeEntity& entity1, const AmeEntity& entity2) {
@@ -127,21 +535,35 @@ bool SpatialGraph::isFrontOf(const AmeEntity& entity1, const AmeEntity& entity2)
     return entity1.obb.center.z() > entity2.obb.center.z() + 0.1f;
 }
 
-bool SpatialGraph::isAdjacent(const AmeEntity& entity1, const AmeEntity& entity2) {
-    float distance = computeDistance(entity1.obb, entity2.obb);
-    return distance < 0.1f;
+SpatialGraph::PairGeometry SpatialGraph::computePairGeometry(const OBB& obb1, const OBB& obb2) {
+    float values[2][kOBBColumns];
+    float* columns[2][kOBBColumns];
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < kOBBColumns; ++c) {
+            columns[side][c] = &values[side][c];
+        }
+    }
+    packOBB(obb1, columns[0], 0);
+    packOBB(obb2, columns[1], 0);
+    
+    uint8_t contains = 0, contained_by = 0;
+    PairGeometry geometry;
+    computeOBBPairs(1, columns[0], columns[1], &geometry.separation, &geometry.distance, &contains, &contained_by);
+    geometry.contains = contains;
+    geometry.contained_by = contained_by;
+    return geometry;
 }
 
 float SpatialGraph::computeDistance(const OBB& obb1, const OBB& obb2) {
-    // Simplified distance computation: distance between centers
-    return (obb1.center - obb2.center).norm();
+    return computePairGeometry(obb1, obb2).distance;
 }
 
 bool SpatialGraph::intersects(const OBB& obb1, const OBB& obb2) {
-    // Simplified intersection check: bounding sphere check
-    float distance = (obb1.center - obb2.center).norm();
-    float radius_sum = obb1.extents.norm() + obb2.extents.norm();
-    return distance < radius_sum;
+    return computePairGeometry(obb1, obb2).separation <= 0.0f;
+}
+
+bool SpatialGraph::contains(const OBB& container, const OBB& contained) {
+    return computePairGeometry(container, contained).contains;
 }
 
 bool SpatialGraph::visualize(const std::string& output_file) const {
@@ -154,10 +576,12 @@ bool SpatialGraph::visualize(const std::string& output_file) const {
     file << "digraph SpatialGraph {" << std::endl;
     file << "  node [shape=box];" << std::endl;
     
-    for (const auto& relationship : relationships_) {
-        file << "  " << relationship.source_id << " -> " << relationship.target_id 
-             << " [label=\"" << relationship.relationship_type 
-             << " (" << relationship.confidence << ")\"];" << std::endl;
+    for (uint32_t source = 0; source < entity_ids_.size(); ++source) {
+        for (uint32_t e = row_offsets_[source]; e < row_offsets_[source + 1]; ++e) {
+            file << "  " << entity_ids_[source] << " -> " << entity_ids_[targets_[e]]
+                 << " [label=\"" << getRelationshipName(types_[e])
+                 << " (" << getConfidence(types_[e]) << ")\"];" << std::endl;
+        }
     }
     
     file << "}" << std::endl;
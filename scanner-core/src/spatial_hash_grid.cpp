@@ -0,0 +1,33 @@
+#include "spatial_hash_grid.h"
+
+namespace AmeScanner {
+
+void SpatialHashGrid::reset(float cell_size) {
+    cell_size_ = cell_size;
+    inv_cell_size_ = 1.0f / cell_size;
+    positions_.clear();
+    cells_.clear();
+}
+
+uint32_t SpatialHashGrid::insert(const Eigen::Vector3f& position) {
+    uint32_t idx = static_cast<uint32_t>(positions_.size());
+    positions_.push_back(position);
+    cells_[packKey(cellCoord(position.x()), cellCoord(position.y()), cellCoord(position.z()))].push_back(idx);
+    return idx;
+}
+
+void SpatialHashGrid::radiusQuery(const Eigen::Vector3f& center, float radius, std::vector<uint32_t>& out) const {
+    out.clear();
+    forEachInRadius(center, radius, [&out](uint32_t idx) { out.push_back(idx); });
+}
+
+uint64_t SpatialHashGrid::packKey(int x, int y, int z) {
+    // 21 bits per axis, biased so negative cell coordinates stay distinct
+    constexpr int64_t kBias = int64_t(1) << 20;
+    constexpr uint64_t kMask = (uint64_t(1) << 21) - 1;
+    return ((static_cast<uint64_t>(x + kBias) & kMask) << 42) |
+           ((static_cast<uint64_t>(y + kBias) & kMask) << 21) |
+           (static_cast<uint64_t>(z + kBias) & kMask);
+}
+
+} // namespace AmeScanner
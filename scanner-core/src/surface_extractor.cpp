@@ -1,61 +1,175 @@
 #include "surface_extractor.h"
+#include "thread_pool.h"
+#include "symmetric_eigen.h"
+#include "union_find.h"
 #include <iostream>
 #include <chrono>
-#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <array>
 
 namespace AmeScanner {
 
+namespace {
+
+// In-place box sum of a dense grid along one axis: each value becomes the
+// sum of the 2 * half_width + 1 values centered on it, zeros past the ends
+void boxSumAxis(std::vector<double>& grid, const Eigen::Vector3i& dims, int axis, int half_width) {
+    constexpr size_t kColumns = 256;
+    const size_t length = dims[axis];
+    const size_t k = static_cast<size_t>(half_width);
+    size_t inner = 1;  // Distance between neighbors along the axis
+    for (int a = 0; a < axis; ++a) {
+        inner *= dims[a];
+    }
+    
+    // Along x every line is contiguous: slide a running window over a copy
+    if (inner == 1) {
+        ThreadPool::global().parallelFor(grid.size() / length, 64, [&](size_t begin, size_t end, size_t) {
+            std::vector<double> line(length);
+            for (size_t l = begin; l < end; ++l) {
+                double* values = grid.data() + l * length;
+                std::copy(values, values + length, line.begin());
+                double window = 0.0;
+                for (size_t i = 0; i < std::min(length, k); ++i) {
+                    window += line[i];
+                }
+                for (size_t i = 0; i < length; ++i) {
+                    if (i + k < length) {
+                        window += line[i + k];
+                    }
+                    values[i] = window;
+                    if (i >= k) {
+                        window -= line[i - k];
+                    }
+                }
+            }
+        });
+        return;
+    }
+    
+    // Along y and z, prefix sums run over whole rows, kColumns adjacent
+    // lines at a time, so the passes stream memory like the x pass
+    const size_t outer = grid.size() / (inner * length);
+    const size_t column_blocks = (inner + kColumns - 1) / kColumns;
+    ThreadPool::global().parallelFor(outer * column_blocks, 1, [&](size_t begin, size_t end, size_t) {
+        std::vector<double> prefix((length + 1) * kColumns);
+        for (size_t task = begin; task < end; ++task) {
+            const size_t first_column = (task % column_blocks) * kColumns;
+            const size_t columns = std::min(kColumns, inner - first_column);
+            double* values = grid.data() + (task / column_blocks) * inner * length + first_column;
+            
+            std::fill(prefix.begin(), prefix.begin() + columns, 0.0);
+            for (size_t i = 0; i < length; ++i) {
+                const double* row = values + i * inner;
+                const double* previous = prefix.data() + i * kColumns;
+                double* next = prefix.data() + (i + 1) * kColumns;
+                for (size_t c = 0; c < columns; ++c) {
+                    next[c] = previous[c] + row[c];
+                }
+            }
+            for (size_t i = 0; i < length; ++i) {
+                const size_t lo = i > k ? i - k : 0;
+                const size_t hi = std::min(length, i + k + 1);
+                const double* upper = prefix.data() + hi * kColumns;
+                const double* lower = prefix.data() + lo * kColumns;
+                double* row = values + i * inner;
+                for (size_t c = 0; c < columns; ++c) {
+                    row[c] = upper[c] - lower[c];
+                }
+            }
+        }
+    });
+}
+
+} // namespace
+
 std::vector<std::vector<size_t>> SurfaceExtractor::extractSurfaceCandidates(const std::vector<Gaussian>& gaussians) {
     auto start_time = std::chrono::high_resolution_clock::now();
     
     size_t n = gaussians.size();
     normals_.resize(n);
     curvatures_.resize(n);
+    eigenvalues_.resize(n);
+    flatness_.resize(n);
+    
+    // Flatness of every splat; in SplatShape mode splats flat enough to
+    // orient take their shape straight from their own covariance
+    std::vector<uint8_t> from_splat(n, 0);
+    ThreadPool::global().parallelFor(n, 1024, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            flatness_[i] = splatFlatness(gaussians[i].getScale());
+            if (normal_mode_ == NormalMode::SplatShape && flatness_[i] >= min_flatness_) {
+                LocalShape shape = shapeFromSplat(gaussians[i]);
+                normals_[i] = shape.normal;
+                curvatures_[i] = shape.curvature;
+                eigenvalues_[i] = shape.eigenvalues;
+                from_splat[i] = 1;
+            }
+        }
+    });
     
-    // Compute normals and curvatures for all gaussians
+    std::vector<size_t> fallbacks;
     for (size_t i = 0; i < n; ++i) {
-        normals_[i] = computeNormal(gaussians, i);
-        curvatures_[i] = computeCurvature(gaussians, i);
+        if (!from_splat[i]) {
+            fallbacks.push_back(i);
+        }
+    }
+    num_fallbacks_ = fallbacks.size();
+    
+    // Index positions once so every neighborhood is a local query
+    index_.reset(kNeighborhoodRadius);
+    for (const auto& gaussian : gaussians) {
+        index_.insert(gaussian.getPosition());
     }
+    estimateNeighborhoodShapes(fallbacks);
     
     // Mark surface candidates
-    std::vector<bool> is_surface_candidate(n, false);
+    std::vector<uint8_t> is_surface_candidate(n, 0);
     for (size_t i = 0; i < n; ++i) {
         // Check if curvature is below threshold (indicating smooth surface)
         if (curvatures_[i] < curvature_threshold_) {
-            is_surface_candidate[i] = true;
+            is_surface_candidate[i] = 1;
         }
     }
     
-    // Group surface candidates into connected regions
-    std::vector<std::vector<size_t>> surface_candidates;
-    std::vector<bool> visited(n, false);
+    // Group surface candidates into connected regions: every candidate
+    // unites with the later candidates within the grouping radius, in
+    // parallel over the index
+    ConcurrentUnionFind sets(n);
+    ThreadPool::global().parallelFor(n, 256, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!is_surface_candidate[i]) {
+                continue;
+            }
+            index_.forEachInRadius(index_.getPosition(static_cast<uint32_t>(i)), grouping_radius_, [&](uint32_t idx) {
+                if (idx > i && is_surface_candidate[idx]) {
+                    sets.unite(static_cast<uint32_t>(i), idx);
+                }
+            });
+        }
+    });
     
+    // Roots are the smallest members, so walking in order meets each root
+    // first; regions come out ordered by first member, members ascending
+    std::vector<std::vector<size_t>> regions;
+    std::vector<uint32_t> region_of_root(n);
     for (size_t i = 0; i < n; ++i) {
-        if (is_surface_candidate[i] && !visited[i]) {
-            std::vector<size_t> candidate_region;
-            std::vector<size_t> queue = {i};
-            visited[i] = true;
-            
-            while (!queue.empty()) {
-                size_t current_idx = queue.back();
-                queue.pop_back();
-                candidate_region.push_back(current_idx);
-                
-                // Find neighbors
-                std::vector<size_t> neighbors = findNeighbors(gaussians, current_idx, 0.2f);
-                for (size_t neighbor_idx : neighbors) {
-                    if (is_surface_candidate[neighbor_idx] && !visited[neighbor_idx]) {
-                        queue.push_back(neighbor_idx);
-                        visited[neighbor_idx] = true;
-                    }
-                }
-            }
-            
-            // Only add regions with sufficient size
-            if (candidate_region.size() >= 5) {
-                surface_candidates.push_back(candidate_region);
-            }
+        if (!is_surface_candidate[i]) {
+            continue;
+        }
+        uint32_t root = sets.find(static_cast<uint32_t>(i));
+        if (root == i) {
+            region_of_root[i] = static_cast<uint32_t>(regions.size());
+            regions.emplace_back();
+        }
+        regions[region_of_root[root]].push_back(i);
+    }
+    
+    // Only add regions with sufficient size
+    std::vector<std::vector<size_t>> surface_candidates;
+    for (auto& region : regions) {
+        if (region.size() >= min_region_size_) {
+            surface_candidates.push_back(std::move(region));
         }
     }
     
@@ -68,24 +182,172 @@ std::vector<std::vector<size_t>> SurfaceExtractor::extractSurfaceCandidates(cons
     return surface_candidates;
 }
 
+bool SurfaceExtractor::computeMultiScaleCurvatures(const std::vector<Gaussian>& gaussians, const std::vector<float>& radii, float voxel_size) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    const size_t n = gaussians.size();
+    multi_scale_curvatures_.assign(radii.size(), std::vector<float>(n, 1.0f));
+    if (n == 0 || radii.empty()) {
+        return true;
+    }
+    if (voxel_size <= 0.0f) {
+        voxel_size = 0.5f * *std::min_element(radii.begin(), radii.end());
+    }
+    
+    Eigen::Vector3f min_bounds = gaussians[0].getPosition(), max_bounds = min_bounds;
+    for (const auto& gaussian : gaussians) {
+        min_bounds = min_bounds.cwiseMin(gaussian.getPosition());
+        max_bounds = max_bounds.cwiseMax(gaussian.getPosition());
+    }
+    Eigen::Vector3i dims = ((max_bounds - min_bounds) / voxel_size).array().floor().cast<int>() + 1;
+    const size_t num_voxels = static_cast<size_t>(dims.x()) * dims.y() * dims.z();
+    if (num_voxels > kMaxMomentVoxels) {
+        std::cerr << "Moment grid of " << num_voxels << " voxels is too large; use a larger voxel size" << std::endl;
+        return false;
+    }
+    
+    // Coordinates are taken about the grid center and summed in double so
+    // the one-pass covariance stays accurate across large scenes
+    const Eigen::Vector3d center = (0.5f * (min_bounds + max_bounds)).cast<double>();
+    std::vector<uint32_t> voxel_of(n);
+    std::vector<Eigen::Vector3d> offsets(n);
+    for (size_t i = 0; i < n; ++i) {
+        Eigen::Vector3i voxel = ((gaussians[i].getPosition() - min_bounds) / voxel_size).array().floor().cast<int>();
+        voxel = voxel.cwiseMax(0).cwiseMin(dims - Eigen::Vector3i::Ones());
+        voxel_of[i] = static_cast<uint32_t>((static_cast<size_t>(voxel.z()) * dims.y() + voxel.y()) * dims.x() + voxel.x());
+        offsets[i] = gaussians[i].getPosition().cast<double>() - center;
+    }
+    
+    // Occupied voxels in ascending order and each gaussian's slot among them
+    std::vector<uint32_t> occupied(voxel_of);
+    std::sort(occupied.begin(), occupied.end());
+    occupied.erase(std::unique(occupied.begin(), occupied.end()), occupied.end());
+    const size_t m = occupied.size();
+    std::vector<uint32_t> slot_of(n);
+    for (size_t i = 0; i < n; ++i) {
+        slot_of[i] = static_cast<uint32_t>(std::lower_bound(occupied.begin(), occupied.end(), voxel_of[i]) - occupied.begin());
+    }
+    
+    // Moment channels per occupied voxel, accumulated once: count, sum (3)
+    // and packed sum of outer products (6)
+    constexpr int kChannels = 10;
+    constexpr int kOuter[6][2] = {{0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {2, 2}};
+    std::vector<std::array<double, kChannels>> moments(m);
+    for (auto& voxel_moments : moments) {
+        voxel_moments.fill(0.0);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        const Eigen::Vector3d& x = offsets[i];
+        auto& voxel_moments = moments[slot_of[i]];
+        voxel_moments[0] += 1.0;
+        for (int axis = 0; axis < 3; ++axis) {
+            voxel_moments[1 + axis] += x[axis];
+        }
+        for (int c = 0; c < 6; ++c) {
+            voxel_moments[4 + c] += x[kOuter[c][0]] * x[kOuter[c][1]];
+        }
+    }
+    
+    // Per radius, each channel is scattered into the grid, box-summed by
+    // three separable passes and read back at the occupied voxels. Every
+    // gaussian in a voxel shares its cube, so covariances and eigenvalues
+    // are computed per occupied voxel. Occupied voxels are distinct, so the
+    // scatter and gather run in parallel.
+    std::vector<double> grid(num_voxels);
+    std::vector<std::array<double, kChannels>> sums(m);
+    std::vector<float> packed(6 * m), values(3 * m), vectors(9 * m), voxel_curvatures(m);
+    
+    for (size_t scale = 0; scale < radii.size(); ++scale) {
+        const int half_width = std::max(1, static_cast<int>(std::lround(radii[scale] / voxel_size)));
+        for (int channel = 0; channel < kChannels; ++channel) {
+            ThreadPool::global().parallelFor(num_voxels, size_t(1) << 16, [&](size_t begin, size_t end, size_t) {
+                std::fill(grid.begin() + begin, grid.begin() + end, 0.0);
+            });
+            ThreadPool::global().parallelFor(m, 4096, [&](size_t begin, size_t end, size_t) {
+                for (size_t v = begin; v < end; ++v) {
+                    grid[occupied[v]] = moments[v][channel];
+                }
+            });
+            for (int axis = 0; axis < 3; ++axis) {
+                boxSumAxis(grid, dims, axis, half_width);
+            }
+            ThreadPool::global().parallelFor(m, 4096, [&](size_t begin, size_t end, size_t) {
+                for (size_t v = begin; v < end; ++v) {
+                    sums[v][channel] = grid[occupied[v]];
+                }
+            });
+        }
+        
+        // Covariances of every cube, then eigenvalues in batches
+        ThreadPool::global().parallelFor(m, 1024, [&](size_t begin, size_t end, size_t) {
+            for (size_t v = begin; v < end; ++v) {
+                const double count = sums[v][0];
+                const Eigen::Vector3d mean = Eigen::Vector3d(sums[v][1], sums[v][2], sums[v][3]) / count;
+                const double mean_products[6] = {
+                    mean.x() * mean.x(), mean.x() * mean.y(), mean.x() * mean.z(),
+                    mean.y() * mean.y(), mean.y() * mean.z(), mean.z() * mean.z()
+                };
+                for (int c = 0; c < 6; ++c) {
+                    packed[c * m + v] = static_cast<float>(sums[v][4 + c] / count - mean_products[c]);
+                }
+            }
+            
+            const float* packed_columns[6];
+            float* value_columns[3];
+            float* vector_columns[9];
+            for (int c = 0; c < 6; ++c) {
+                packed_columns[c] = packed.data() + c * m + begin;
+            }
+            for (int k = 0; k < 3; ++k) {
+                value_columns[k] = values.data() + k * m + begin;
+            }
+            for (int c = 0; c < 9; ++c) {
+                vector_columns[c] = vectors.data() + c * m + begin;
+            }
+            solveSymmetricEigen3(end - begin, packed_columns, value_columns, vector_columns);
+            
+            // Same curvature as the indexed pass; fewer than three points
+            // keep high curvature
+            for (size_t v = begin; v < end; ++v) {
+                voxel_curvatures[v] = 1.0f;
+                if (sums[v][0] >= 3.0) {
+                    voxel_curvatures[v] = shapeFromEigen(
+                        Eigen::Vector3f(values[v], values[m + v], values[2 * m + v]),
+                        Eigen::Vector3f(vectors[v], vectors[m + v], vectors[2 * m + v])
+                    ).curvature;
+                }
+            }
+        });
+        for (size_t i = 0; i < n; ++i) {
+            multi_scale_curvatures_[scale][i] = voxel_curvatures[slot_of[i]];
+        }
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    float duration_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    std::cout << "Multi-scale curvature at " << radii.size() << " radii over " << dims.x() << "x" << dims.y() << "x" << dims.z()
+              << " voxels completed in " << duration_ms << " ms" << std::endl;
+    return true;
+}
+
 Eigen::Vector3f SurfaceExtractor::computeNormal(const std::vector<Gaussian>& gaussians, size_t gaussian_idx) {
-    std::vector<size_t> neighbors = findNeighbors(gaussians, gaussian_idx, 0.1f);
-    if (neighbors.size() < 3) {
-        // Not enough neighbors, return default normal
-        return Eigen::Vector3f(0.0f, 1.0f, 0.0f);
+    if (useSplatShape(gaussians[gaussian_idx])) {
+        return shapeFromSplat(gaussians[gaussian_idx]).normal;
     }
     
-    return estimateNormalFromNeighbors(gaussians, neighbors);
+    // Not enough neighbors leaves the default normal
+    std::vector<size_t> neighbors = findNeighbors(gaussians, gaussian_idx, kNeighborhoodRadius);
+    return estimateShapeFromNeighbors(gaussians, neighbors).normal;
 }
 
 float SurfaceExtractor::computeCurvature(const std::vector<Gaussian>& gaussians, size_t gaussian_idx) {
-    std::vector<size_t> neighbors = findNeighbors(gaussians, gaussian_idx, 0.1f);
-    if (neighbors.size() < 3) {
-        // Not enough neighbors, return high curvature
-        return 1.0f;
+    if (useSplatShape(gaussians[gaussian_idx])) {
+        return shapeFromSplat(gaussians[gaussian_idx]).curvature;
     }
     
-    return estimateCurvatureFromNeighbors(gaussians, neighbors);
+    // Not enough neighbors leaves high curvature
+    std::vector<size_t> neighbors = findNeighbors(gaussians, gaussian_idx, kNeighborhoodRadius);
+    return estimateShapeFromNeighbors(gaussians, neighbors).curvature;
 }
 
 std::vector<size_t> SurfaceExtractor::findNeighbors(const std::vector<Gaussian>& gaussians, size_t gaussian_idx, float radius) {
@@ -106,7 +368,91 @@ std::vector<size_t> SurfaceExtractor::findNeighbors(const std::vector<Gaussian>&
     return neighbors;
 }
 
-Eigen::Vector3f SurfaceExtractor::estimateNormalFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors) {
+bool SurfaceExtractor::useSplatShape(const Gaussian& gaussian) const {
+    return normal_mode_ == NormalMode::SplatShape && splatFlatness(gaussian.getScale()) >= min_flatness_;
+}
+
+void SurfaceExtractor::estimateNeighborhoodShapes(const std::vector<size_t>& indices) {
+    // Gather each neighborhood once and get normal, curvature and
+    // eigenvalues from a single covariance. Moments are taken about the
+    // query point, which keeps the one-pass covariance well conditioned.
+    // Covariances are decomposed kEigenBatchSize at a time by the batched
+    // solver.
+    ThreadPool::global().parallelFor(indices.size(), 256, [&](size_t begin, size_t end, size_t) {
+        for (size_t block = begin; block < end; block += kEigenBatchSize) {
+            const size_t block_size = std::min<size_t>(kEigenBatchSize, end - block);
+            float packed[6][kEigenBatchSize];
+            float values[3][kEigenBatchSize];
+            float vectors[9][kEigenBatchSize];
+            bool has_shape[kEigenBatchSize];
+            
+            for (size_t j = 0; j < block_size; ++j) {
+                const size_t i = indices[block + j];
+                const Eigen::Vector3f& center = index_.getPosition(static_cast<uint32_t>(i));
+                Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+                Eigen::Matrix3f sum_sq = Eigen::Matrix3f::Zero();
+                size_t count = 0;
+                index_.forEachInRadius(center, kNeighborhoodRadius, [&](uint32_t idx) {
+                    if (idx == i) {
+                        return;
+                    }
+                    Eigen::Vector3f offset = index_.getPosition(idx) - center;
+                    sum += offset;
+                    sum_sq += offset * offset.transpose();
+                    ++count;
+                });
+                
+                // Too few neighbors decompose a zero matrix and keep the default shape
+                has_shape[j] = count >= 3;
+                Eigen::Matrix3f covariance = Eigen::Matrix3f::Zero();
+                if (has_shape[j]) {
+                    Eigen::Vector3f mean = sum / static_cast<float>(count);
+                    covariance = sum_sq / static_cast<float>(count) - mean * mean.transpose();
+                }
+                packed[0][j] = covariance(0, 0);
+                packed[1][j] = covariance(0, 1);
+                packed[2][j] = covariance(0, 2);
+                packed[3][j] = covariance(1, 1);
+                packed[4][j] = covariance(1, 2);
+                packed[5][j] = covariance(2, 2);
+            }
+            
+            const float* packed_columns[6];
+            float* value_columns[3];
+            float* vector_columns[9];
+            for (int c = 0; c < 6; ++c) {
+                packed_columns[c] = packed[c];
+            }
+            for (int k = 0; k < 3; ++k) {
+                value_columns[k] = values[k];
+            }
+            for (int c = 0; c < 9; ++c) {
+                vector_columns[c] = vectors[c];
+            }
+            solveSymmetricEigen3(block_size, packed_columns, value_columns, vector_columns);
+            
+            for (size_t j = 0; j < block_size; ++j) {
+                LocalShape shape;
+                if (has_shape[j]) {
+                    shape = shapeFromEigen(
+                        Eigen::Vector3f(values[0][j], values[1][j], values[2][j]),
+                        Eigen::Vector3f(vectors[0][j], vectors[1][j], vectors[2][j])
+                    );
+                }
+                const size_t i = indices[block + j];
+                normals_[i] = shape.normal;
+                curvatures_[i] = shape.curvature;
+                eigenvalues_[i] = shape.eigenvalues;
+            }
+        }
+    });
+}
+
+SurfaceExtractor::LocalShape SurfaceExtractor::estimateShapeFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors) {
+    if (neighbors.size() < 3) {
+        return LocalShape();
+    }
+    
     // Compute covariance matrix of neighbor positions
     Eigen::Vector3f mean = Eigen::Vector3f::Zero();
     for (size_t neighbor_idx : neighbors) {
@@ -121,54 +467,62 @@ Eigen::Vector3f SurfaceExtractor::estimateNormalFromNeighbors(const std::vector<
     }
     covariance /= neighbors.size();
     
-    // Compute eigenvalues and eigenvectors
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
-    Eigen::Vector3f eigenvalues = solver.eigenvalues();
-    Eigen::Matrix3f eigenvectors = solver.eigenvectors();
-    
-    // Find smallest eigenvalue (corresponding to normal direction)
-    size_t min_eigenvalue_idx = 0;
-    if (eigenvalues[1] < eigenvalues[min_eigenvalue_idx]) {
-        min_eigenvalue_idx = 1;
-    }
-    if (eigenvalues[2] < eigenvalues[min_eigenvalue_idx]) {
-        min_eigenvalue_idx = 2;
-    }
-    
-    // Return corresponding eigenvector as normal
-    Eigen::Vector3f normal = eigenvectors.col(min_eigenvalue_idx);
-    return normal.normalized();
+    float packed[6];
+    float eigenvalues[3];
+    float eigenvectors[9];
+    packed[0] = covariance(0, 0);
+    packed[1] = covariance(0, 1);
+    packed[2] = covariance(0, 2);
+    packed[3] = covariance(1, 1);
+    packed[4] = covariance(1, 2);
+    packed[5] = covariance(2, 2);
+    solveSymmetricEigen3(packed, eigenvalues, eigenvectors);
+    return shapeFromEigen(
+        Eigen::Vector3f(eigenvalues[0], eigenvalues[1], eigenvalues[2]),
+        Eigen::Vector3f(eigenvectors[0], eigenvectors[1], eigenvectors[2])
+    );
 }
 
-float SurfaceExtractor::estimateCurvatureFromNeighbors(const std::vector<Gaussian>& gaussians, const std::vector<size_t>& neighbors) {
-    // Compute covariance matrix of neighbor positions
-    Eigen::Vector3f mean = Eigen::Vector3f::Zero();
-    for (size_t neighbor_idx : neighbors) {
-        mean += gaussians[neighbor_idx].getPosition();
+float SurfaceExtractor::splatFlatness(const Eigen::Vector3f& scale) {
+    Eigen::Vector3f sorted = scale.cwiseAbs();
+    std::sort(sorted.data(), sorted.data() + 3);
+    if (sorted[1] <= 0.0f) {
+        return 0.0f;
     }
-    mean /= neighbors.size();
+    return 1.0f - sorted[0] / sorted[1];
+}
+
+SurfaceExtractor::LocalShape SurfaceExtractor::shapeFromSplat(const Gaussian& gaussian) {
+    // The splat covariance R * S^2 * R^T has eigenvalues scale^2 and
+    // eigenvectors the rotated axes; the shortest axis is the normal
+    Eigen::Vector3f scale = gaussian.getScale().cwiseAbs();
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&](int a, int b) { return scale[a] < scale[b]; });
     
-    Eigen::Matrix3f covariance = Eigen::Matrix3f::Zero();
-    for (size_t neighbor_idx : neighbors) {
-        Eigen::Vector3f pos = gaussians[neighbor_idx].getPosition() - mean;
-        covariance += pos * pos.transpose();
+    Eigen::Vector3f eigenvalues;
+    for (int k = 0; k < 3; ++k) {
+        eigenvalues[k] = scale[order[k]] * scale[order[k]];
     }
-    covariance /= neighbors.size();
-    
-    // Compute eigenvalues
-    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(covariance);
-    Eigen::Vector3f eigenvalues = solver.eigenvalues();
+    Eigen::Matrix3f rotation = gaussian.getRotation().normalized().toRotationMatrix();
+    return shapeFromEigen(eigenvalues, rotation.col(order[0]));
+}
+
+SurfaceExtractor::LocalShape SurfaceExtractor::shapeFromEigen(const Eigen::Vector3f& eigenvalues, const Eigen::Vector3f& smallest_eigenvector) {
+    LocalShape shape;
+    shape.eigenvalues = eigenvalues;
     
-    // Compute curvature as ratio of smallest to largest eigenvalue
-    float max_eigenvalue = eigenvalues.maxCoeff();
-    float min_eigenvalue = eigenvalues.minCoeff();
+    // Smallest eigenvalue's eigenvector is the normal direction
+    shape.normal = smallest_eigenvector.normalized();
     
+    // Curvature from the ratio of smallest to largest eigenvalue
+    float max_eigenvalue = shape.eigenvalues[2];
+    float min_eigenvalue = shape.eigenvalues[0];
     if (max_eigenvalue < 1e-6) {
-        return 0.0f; // Flat region
+        shape.curvature = 0.0f; // Flat region
+    } else {
+        shape.curvature = 1.0f - min_eigenvalue / max_eigenvalue; // Higher value indicates more curvature
     }
-    
-    float curvature = min_eigenvalue / max_eigenvalue;
-    return 1.0f - curvature; // Higher value indicates more curvature
+    return shape;
 }
 
 } // namespace AmeScanner
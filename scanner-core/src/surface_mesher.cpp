@@ -0,0 +1,518 @@
+#include "surface_mesher.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cstring>
+#include <tuple>
+#include <bit>
+
+namespace AmeScanner {
+
+namespace {
+
+constexpr int kBrickSize = SparseDensityField::kBrickSize;
+constexpr int kBlockSamples = kBrickSize + 1;  // Cells of a brick read one voxel past it
+constexpr size_t kBlockCells = SparseDensityField::kBrickVoxels;
+
+// Cell keys pack 21 bits per axis relative to the region's first cell
+constexpr int kCellKeyBits = 21;
+
+// A brick-sized block of cells of one region. Cell c belongs to the block
+// of brick floor(c / kBrickSize) and has the voxels c + {0, 1}^3 as corners.
+struct MeshBlock {
+    uint32_t region;
+    Eigen::Vector3i brick;
+    
+    bool operator<(const MeshBlock& other) const {
+        return std::tie(region, brick.z(), brick.y(), brick.x()) <
+               std::tie(other.region, other.brick.z(), other.brick.y(), other.brick.x());
+    }
+    bool operator==(const MeshBlock& other) const {
+        return region == other.region && brick == other.brick;
+    }
+};
+
+// Open-addressing map from cell key to vertex index. Threads insert
+// distinct keys concurrently by claiming empty slots with a CAS; lookups
+// run after all inserts have finished.
+class CellVertexTable {
+public:
+    void reset(size_t capacity) {
+        size_t size = 16;
+        while (size < 2 * capacity) {
+            size *= 2;
+        }
+        keys_ = std::make_unique<std::atomic<uint64_t>[]>(size);
+        values_.assign(size, 0);
+        mask_ = size - 1;
+        shift_ = 64 - std::countr_zero(size);
+        for (size_t i = 0; i < size; ++i) {
+            keys_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    
+    void insert(uint64_t key, uint32_t value) {
+        for (size_t slot = hash(key);; slot = (slot + 1) & mask_) {
+            uint64_t expected = 0;
+            if (keys_[slot].compare_exchange_strong(expected, key, std::memory_order_relaxed) || expected == key) {
+                values_[slot] = value;
+                return;
+            }
+        }
+    }
+    
+    // Vertex of key, or -1
+    int64_t find(uint64_t key) const {
+        for (size_t slot = hash(key);; slot = (slot + 1) & mask_) {
+            uint64_t stored = keys_[slot].load(std::memory_order_relaxed);
+            if (stored == key) {
+                return values_[slot];
+            }
+            if (stored == 0) {
+                return -1;
+            }
+        }
+    }
+    
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> keys_;  // 0 marks an empty slot
+    std::vector<uint32_t> values_;
+    size_t mask_ = 0;
+    int shift_ = 64;
+    
+    // Fibonacci hashing: the top bits of the product mix all key bits
+    size_t hash(uint64_t key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+};
+
+// Nonzero key of a cell relative to the first cell of its region
+uint64_t packCellKey(const Eigen::Vector3i& cell, const Eigen::Vector3i& first_cell) {
+    Eigen::Vector3i rel = cell - first_cell;
+    return ((static_cast<uint64_t>(rel.x()) << (2 * kCellKeyBits)) |
+            (static_cast<uint64_t>(rel.y()) << kCellKeyBits) |
+            static_cast<uint64_t>(rel.z())) + 1;
+}
+
+inline int sampleIndex(int x, int y, int z) {
+    return (z * kBlockSamples + y) * kBlockSamples + x;
+}
+
+// Density over the cell corners of a block as seen by one region: voxels of
+// other regions read as zero so that touching regions stay apart
+void gatherBlockSamples(
+    const SparseDensityField& field,
+    const std::vector<int32_t>& voxel_labels,
+    const MeshBlock& block,
+    float iso_level,
+    float* samples
+) {
+    for (int dz = 0; dz < 2; ++dz) {
+        for (int dy = 0; dy < 2; ++dy) {
+            for (int dx = 0; dx < 2; ++dx) {
+                int64_t brick = field.findBrick(block.brick + Eigen::Vector3i(dx, dy, dz));
+                const float* values = brick == SparseDensityField::kNoBrick ? nullptr : field.getBrickValues(brick);
+                const int32_t* labels = brick == SparseDensityField::kNoBrick ? nullptr :
+                    voxel_labels.data() + brick * SparseDensityField::kBrickVoxels;
+                for (int z = dz * kBrickSize; z < (dz ? kBlockSamples : kBrickSize); ++z) {
+                    for (int y = dy * kBrickSize; y < (dy ? kBlockSamples : kBrickSize); ++y) {
+                        for (int x = dx * kBrickSize; x < (dx ? kBlockSamples : kBrickSize); ++x) {
+                            float value = 0.0f;
+                            if (values) {
+                                int local = ((z - dz * kBrickSize) * kBrickSize + (y - dy * kBrickSize)) * kBrickSize + (x - dx * kBrickSize);
+                                value = values[local];
+                                if (value >= iso_level && labels[local] != static_cast<int32_t>(block.region)) {
+                                    value = 0.0f;
+                                }
+                            }
+                            samples[sampleIndex(x, y, z)] = value;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Surface-net vertex of a crossed cell in cell-local coordinates, [0, 1]^3
+Eigen::Vector3f cellVertex(const float corners[8], float iso_level) {
+    static constexpr int kEdges[12][2] = {
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},  // Along x
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},  // Along y
+        {0, 4}, {1, 5}, {2, 6}, {3, 7}   // Along z
+    };
+    Eigen::Vector3f sum = Eigen::Vector3f::Zero();
+    int crossings = 0;
+    for (const auto& edge : kEdges) {
+        float a = corners[edge[0]];
+        float b = corners[edge[1]];
+        if ((a >= iso_level) == (b >= iso_level)) {
+            continue;
+        }
+        float t = (iso_level - a) / (b - a);
+        Eigen::Vector3f pa(edge[0] & 1, (edge[0] >> 1) & 1, (edge[0] >> 2) & 1);
+        Eigen::Vector3f pb(edge[1] & 1, (edge[1] >> 1) & 1, (edge[1] >> 2) & 1);
+        sum += pa + t * (pb - pa);
+        ++crossings;
+    }
+    return sum / static_cast<float>(crossings);
+}
+
+} // namespace
+
+std::vector<TriangleMesh> SurfaceMesher::meshRegions(
+    const SparseDensityField& field,
+    const std::vector<int32_t>& voxel_labels,
+    size_t num_regions,
+    float iso_level
+) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    
+    std::vector<TriangleMesh> meshes(num_regions);
+    auto& pool = ThreadPool::global();
+    
+    // Blocks whose cells can touch a region: every brick holding one of its
+    // voxels, and the bricks just below it, whose last cells reach into it
+    std::vector<std::vector<MeshBlock>> worker_blocks(pool.getNumThreads());
+    pool.parallelFor(field.getNumBricks(), 64, [&](size_t begin, size_t end, size_t worker_id) {
+        auto& blocks = worker_blocks[worker_id];
+        for (size_t b = begin; b < end; ++b) {
+            const int32_t* labels = voxel_labels.data() + b * SparseDensityField::kBrickVoxels;
+            int32_t last = -1;
+            for (size_t v = 0; v < SparseDensityField::kBrickVoxels; ++v) {
+                if (labels[v] < 0 || labels[v] == last) {
+                    continue;
+                }
+                last = labels[v];
+                for (int corner = 0; corner < 8; ++corner) {
+                    Eigen::Vector3i offset(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+                    blocks.push_back({static_cast<uint32_t>(last), field.getBrickCoord(b) - offset});
+                }
+            }
+        }
+    });
+    std::vector<MeshBlock> blocks;
+    for (auto& worker : worker_blocks) {
+        blocks.insert(blocks.end(), worker.begin(), worker.end());
+    }
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    
+    // Blocks of region r are blocks[region_offsets[r] .. region_offsets[r + 1])
+    std::vector<size_t> region_offsets(num_regions + 1, 0);
+    for (const auto& block : blocks) {
+        region_offsets[block.region + 1]++;
+    }
+    for (size_t r = 0; r < num_regions; ++r) {
+        region_offsets[r + 1] += region_offsets[r];
+    }
+    
+    // Regions whose cells do not fit the key are left unmeshed
+    std::vector<Eigen::Vector3i> first_cells(num_regions, Eigen::Vector3i::Zero());
+    std::vector<uint8_t> meshable(num_regions, 1);
+    for (size_t r = 0; r < num_regions; ++r) {
+        if (region_offsets[r] == region_offsets[r + 1]) {
+            continue;
+        }
+        Eigen::Vector3i lo = blocks[region_offsets[r]].brick;
+        Eigen::Vector3i hi = lo;
+        for (size_t k = region_offsets[r]; k < region_offsets[r + 1]; ++k) {
+            lo = lo.cwiseMin(blocks[k].brick);
+            hi = hi.cwiseMax(blocks[k].brick);
+        }
+        first_cells[r] = lo * kBrickSize;
+        if (((hi - lo + Eigen::Vector3i::Ones()) * kBrickSize).maxCoeff() >= (1 << kCellKeyBits)) {
+            std::cerr << "Region " << r << " spans too many voxels to mesh" << std::endl;
+            meshable[r] = 0;
+        }
+    }
+    
+    // Pass 1: place a vertex in every crossed cell of every block
+    struct BlockVertices {
+        std::vector<uint16_t> cells;  // Cell index within the block, x fastest
+        std::vector<Eigen::Vector3f> positions;
+    };
+    std::vector<BlockVertices> block_vertices(blocks.size());
+    const Eigen::Vector3f origin = field.getOrigin();
+    const float voxel_size = field.getVoxelSize();
+    pool.parallelFor(blocks.size(), 16, [&](size_t begin, size_t end, size_t) {
+        float samples[kBlockSamples * kBlockSamples * kBlockSamples];
+        for (size_t k = begin; k < end; ++k) {
+            const MeshBlock& block = blocks[k];
+            if (!meshable[block.region]) {
+                continue;
+            }
+            gatherBlockSamples(field, voxel_labels, block, iso_level, samples);
+            int inside_samples = 0;
+            for (float sample : samples) {
+                inside_samples += sample >= iso_level;
+            }
+            if (inside_samples == 0 || inside_samples == kBlockSamples * kBlockSamples * kBlockSamples) {
+                continue;
+            }
+            
+            auto& out = block_vertices[k];
+            const Eigen::Vector3i first_cell = block.brick * kBrickSize;
+            for (int z = 0; z < kBrickSize; ++z) {
+                for (int y = 0; y < kBrickSize; ++y) {
+                    for (int x = 0; x < kBrickSize; ++x) {
+                        float corners[8];
+                        int inside = 0;
+                        for (int corner = 0; corner < 8; ++corner) {
+                            corners[corner] = samples[sampleIndex(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1))];
+                            inside += corners[corner] >= iso_level;
+                        }
+                        if (inside == 0 || inside == 8) {
+                            continue;
+                        }
+                        Eigen::Vector3f local = cellVertex(corners, iso_level);
+                        Eigen::Vector3f cell = (first_cell + Eigen::Vector3i(x, y, z)).cast<float>();
+                        out.cells.push_back(static_cast<uint16_t>((z * kBrickSize + y) * kBrickSize + x));
+                        out.positions.push_back(origin + (cell + local + Eigen::Vector3f::Constant(0.5f)) * voxel_size);
+                    }
+                }
+            }
+        }
+    });
+    
+    // Number vertices region by region in block order, so the output does not
+    // depend on the thread count, and index them by cell
+    std::vector<uint32_t> vertex_base(blocks.size());
+    std::vector<CellVertexTable> tables(num_regions);
+    for (size_t r = 0; r < num_regions; ++r) {
+        uint32_t count = 0;
+        for (size_t k = region_offsets[r]; k < region_offsets[r + 1]; ++k) {
+            vertex_base[k] = count;
+            count += static_cast<uint32_t>(block_vertices[k].cells.size());
+        }
+        meshes[r].vertices.resize(count);
+        tables[r].reset(count);
+    }
+    pool.parallelFor(blocks.size(), 16, [&](size_t begin, size_t end, size_t) {
+        for (size_t k = begin; k < end; ++k) {
+            const MeshBlock& block = blocks[k];
+            const auto& in = block_vertices[k];
+            auto& mesh = meshes[block.region];
+            for (size_t i = 0; i < in.cells.size(); ++i) {
+                int c = in.cells[i];
+                Eigen::Vector3i cell = block.brick * kBrickSize + Eigen::Vector3i(c % kBrickSize, (c / kBrickSize) % kBrickSize, c / (kBrickSize * kBrickSize));
+                uint32_t vertex = vertex_base[k] + static_cast<uint32_t>(i);
+                mesh.vertices[vertex] = in.positions[i];
+                tables[block.region].insert(packCellKey(cell, first_cells[block.region]), vertex);
+            }
+        }
+    });
+    
+    // Pass 2: one quad per crossed voxel edge, taken by the block of the
+    // cell at the edge's lower end, joining the four cells around the edge
+    std::vector<std::vector<uint32_t>> block_indices(blocks.size());
+    pool.parallelFor(blocks.size(), 16, [&](size_t begin, size_t end, size_t) {
+        float samples[kBlockSamples * kBlockSamples * kBlockSamples];
+        for (size_t k = begin; k < end; ++k) {
+            const MeshBlock& block = blocks[k];
+            if (block_vertices[k].cells.empty()) {
+                continue;
+            }
+            gatherBlockSamples(field, voxel_labels, block, iso_level, samples);
+            
+            // Cells of this block are looked up directly, the rest in the table
+            int64_t block_vertex[kBlockCells];
+            std::fill(block_vertex, block_vertex + kBlockCells, -1);
+            for (size_t i = 0; i < block_vertices[k].cells.size(); ++i) {
+                block_vertex[block_vertices[k].cells[i]] = vertex_base[k] + i;
+            }
+            const auto& table = tables[block.region];
+            const Eigen::Vector3i& first_cell = first_cells[block.region];
+            auto vertexAt = [&](const Eigen::Vector3i& local) {
+                if ((local.array() >= 0).all()) {
+                    return block_vertex[(local.z() * kBrickSize + local.y()) * kBrickSize + local.x()];
+                }
+                return table.find(packCellKey(block.brick * kBrickSize + local, first_cell));
+            };
+            
+            const auto& vertices = meshes[block.region].vertices;
+            auto& out = block_indices[k];
+            for (int z = 0; z < kBrickSize; ++z) {
+                for (int y = 0; y < kBrickSize; ++y) {
+                    for (int x = 0; x < kBrickSize; ++x) {
+                        const Eigen::Vector3i local(x, y, z);
+                        const bool inside = samples[sampleIndex(x, y, z)] >= iso_level;
+                        for (int axis = 0; axis < 3; ++axis) {
+                            Eigen::Vector3i next = local + Eigen::Vector3i::Unit(axis);
+                            if ((samples[sampleIndex(next.x(), next.y(), next.z())] >= iso_level) == inside) {
+                                continue;
+                            }
+                            
+                            // Going c00, c10, c11, c01 turns about +axis
+                            const Eigen::Vector3i eu = Eigen::Vector3i::Unit((axis + 1) % 3);
+                            const Eigen::Vector3i ew = Eigen::Vector3i::Unit((axis + 2) % 3);
+                            int64_t quad[4] = {
+                                vertexAt(local - eu - ew),
+                                vertexAt(local - ew),
+                                vertexAt(local),
+                                vertexAt(local - eu)
+                            };
+                            if (std::min({quad[0], quad[1], quad[2], quad[3]}) < 0) {
+                                continue;
+                            }
+                            if (!inside) {
+                                std::swap(quad[1], quad[3]);
+                            }
+                            
+                            // Split along the shorter diagonal
+                            if ((vertices[quad[0]] - vertices[quad[2]]).squaredNorm() <=
+                                (vertices[quad[1]] - vertices[quad[3]]).squaredNorm()) {
+                                out.insert(out.end(), {uint32_t(quad[0]), uint32_t(quad[1]), uint32_t(quad[2]),
+                                                       uint32_t(quad[0]), uint32_t(quad[2]), uint32_t(quad[3])});
+                            } else {
+                                out.insert(out.end(), {uint32_t(quad[0]), uint32_t(quad[1]), uint32_t(quad[3]),
+                                                       uint32_t(quad[1]), uint32_t(quad[2]), uint32_t(quad[3])});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+    
+    pool.parallelFor(num_regions, 16, [&](size_t begin, size_t end, size_t) {
+        for (size_t r = begin; r < end; ++r) {
+            size_t count = 0;
+            for (size_t k = region_offsets[r]; k < region_offsets[r + 1]; ++k) {
+                count += block_indices[k].size();
+            }
+            meshes[r].indices.reserve(count);
+            for (size_t k = region_offsets[r]; k < region_offsets[r + 1]; ++k) {
+                meshes[r].indices.insert(meshes[r].indices.end(), block_indices[k].begin(), block_indices[k].end());
+            }
+        }
+    });
+    
+    stats_ = Statistics();
+    stats_.num_blocks = blocks.size();
+    for (const auto& mesh : meshes) {
+        stats_.num_vertices += mesh.vertices.size();
+        stats_.num_triangles += mesh.getNumTriangles();
+    }
+    
+    auto end_time = std::chrono::high_resolution_clock::now();
+    stats_.meshing_time_ms = std::chrono::duration<float, std::milli>(end_time - start_time).count();
+    
+    std::cout << "Meshed " << num_regions << " regions (" << stats_.num_vertices << " vertices, "
+              << stats_.num_triangles << " triangles) in " << stats_.meshing_time_ms << " ms" << std::endl;
+    
+    return meshes;
+}
+
+namespace {
+
+struct MeshFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t index_size;  // Bytes per index, 2 or 4
+    uint64_t num_vertices;
+    uint64_t num_triangles;
+    float min_bounds[3];
+    float max_bounds[3];
+};
+
+constexpr char kMeshMagic[8] = {'A', 'M', 'E', 'S', 'H', '\0', '\0', '\0'};
+constexpr uint32_t kMeshVersion = 1;
+
+} // namespace
+
+bool SurfaceMesher::saveMesh(const std::string& file_path, const TriangleMesh& mesh) {
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open mesh file for writing: " << file_path << std::endl;
+        return false;
+    }
+    
+    MeshFileHeader header = {};
+    std::memcpy(header.magic, kMeshMagic, sizeof(kMeshMagic));
+    header.version = kMeshVersion;
+    header.index_size = mesh.vertices.size() <= 0xFFFF ? 2 : 4;
+    header.num_vertices = mesh.vertices.size();
+    header.num_triangles = mesh.getNumTriangles();
+    Eigen::Vector3f lo = Eigen::Vector3f::Zero(), hi = Eigen::Vector3f::Zero();
+    if (!mesh.vertices.empty()) {
+        lo = hi = mesh.vertices.front();
+        for (const auto& vertex : mesh.vertices) {
+            lo = lo.cwiseMin(vertex);
+            hi = hi.cwiseMax(vertex);
+        }
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        header.min_bounds[axis] = lo[axis];
+        header.max_bounds[axis] = hi[axis];
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    
+    for (const auto& vertex : mesh.vertices) {
+        file.write(reinterpret_cast<const char*>(vertex.data()), 3 * sizeof(float));
+    }
+    if (header.index_size == 2) {
+        std::vector<uint16_t> narrow(mesh.indices.begin(), mesh.indices.end());
+        file.write(reinterpret_cast<const char*>(narrow.data()), narrow.size() * sizeof(uint16_t));
+    } else {
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+    }
+    
+    if (!file) {
+        std::cerr << "Failed to write mesh file: " << file_path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SurfaceMesher::loadMesh(const std::string& file_path, TriangleMesh& mesh) {
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open mesh file: " << file_path << std::endl;
+        return false;
+    }
+    
+    MeshFileHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMeshMagic, sizeof(kMeshMagic)) != 0 ||
+        header.version != kMeshVersion || (header.index_size != 2 && header.index_size != 4)) {
+        std::cerr << "Not a supported mesh file: " << file_path << std::endl;
+        return false;
+    }
+    
+    // Check the counts against the file size before allocating anything
+    file.seekg(0, std::ios::end);
+    uint64_t payload = static_cast<uint64_t>(file.tellg()) - sizeof(header);
+    file.seekg(sizeof(header));
+    if (header.num_vertices > payload / (3 * sizeof(float)) || header.num_triangles > payload / (3 * header.index_size) ||
+        header.num_vertices * 3 * sizeof(float) + header.num_triangles * 3 * header.index_size != payload) {
+        std::cerr << "Mesh file is truncated or corrupt: " << file_path << std::endl;
+        return false;
+    }
+    
+    mesh.vertices.resize(header.num_vertices);
+    for (auto& vertex : mesh.vertices) {
+        file.read(reinterpret_cast<char*>(vertex.data()), 3 * sizeof(float));
+    }
+    mesh.indices.resize(header.num_triangles * 3);
+    if (header.index_size == 2) {
+        std::vector<uint16_t> narrow(mesh.indices.size());
+        file.read(reinterpret_cast<char*>(narrow.data()), narrow.size() * sizeof(uint16_t));
+        std::copy(narrow.begin(), narrow.end(), mesh.indices.begin());
+    } else {
+        file.read(reinterpret_cast<char*>(mesh.indices.data()), mesh.indices.size() * sizeof(uint32_t));
+    }
+    
+    if (!file) {
+        std::cerr << "Failed to read mesh file: " << file_path << std::endl;
+        mesh = TriangleMesh();
+        return false;
+    }
+    return true;
+}
+
+} // namespace AmeScanner
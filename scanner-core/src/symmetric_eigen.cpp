@@ -0,0 +1,175 @@
+#include "symmetric_eigen.h"
+#include "simd_dispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace AmeScanner {
+
+namespace {
+
+constexpr int kLanes = kEigenBatchSize;
+constexpr int kMaxSweeps = 8;
+constexpr float kConvergedOffDiagonal = 1e-14f;  // Squared, for unit max entry
+constexpr float kNegligible = 1e-18f;
+
+constexpr int packedIndex(int row, int col) {
+    constexpr int kIndex[3][3] = {{0, 1, 2}, {1, 3, 4}, {2, 4, 5}};
+    return kIndex[row][col];
+}
+
+// Rotate rows/columns P and Q of every lane so that a[P][Q] becomes zero.
+// t = tan(angle) is taken from the stable root, so |t| <= 1.
+template <int P, int Q>
+inline void jacobiRotate(float (&a)[6][kLanes], float (&v)[9][kLanes]) {
+    constexpr int R = 3 - P - Q;
+    constexpr int PP = packedIndex(P, P), QQ = packedIndex(Q, Q), PQ = packedIndex(P, Q);
+    constexpr int RP = packedIndex(R, P), RQ = packedIndex(R, Q);
+
+#pragma GCC unroll 1
+    for (int lane = 0; lane < kLanes; ++lane) {
+        const float app = a[PP][lane], aqq = a[QQ][lane], apq = a[PQ][lane];
+        const float diff = aqq - app;
+        const float two_apq = 2.0f * apq;
+        // denom is zero only when apq is, so clamping it keeps t = 0 there
+        const float denom = std::abs(diff) + std::sqrt(diff * diff + two_apq * two_apq);
+        const float t = std::copysign(1.0f, diff) * two_apq / std::max(denom, std::numeric_limits<float>::min());
+        const float c = 1.0f / std::sqrt(1.0f + t * t);
+        const float s = t * c;
+        
+        a[PP][lane] = app - t * apq;
+        a[QQ][lane] = aqq + t * apq;
+        a[PQ][lane] = 0.0f;
+        const float arp = a[RP][lane], arq = a[RQ][lane];
+        a[RP][lane] = c * arp - s * arq;
+        a[RQ][lane] = s * arp + c * arq;
+        
+        for (int axis = 0; axis < 3; ++axis) {
+            const float vp = v[3 * P + axis][lane], vq = v[3 * Q + axis][lane];
+            v[3 * P + axis][lane] = c * vp - s * vq;
+            v[3 * Q + axis][lane] = s * vp + c * vq;
+        }
+    }
+}
+
+// Order eigenpairs J and K of every lane so that eigenvalue J <= K
+template <int J, int K>
+inline void sortPair(float (&a)[6][kLanes], float (&v)[9][kLanes]) {
+    constexpr int JJ = packedIndex(J, J), KK = packedIndex(K, K);
+
+#pragma GCC unroll 1
+    for (int lane = 0; lane < kLanes; ++lane) {
+        const bool swap = a[JJ][lane] > a[KK][lane];
+        const float lo = swap ? a[KK][lane] : a[JJ][lane];
+        const float hi = swap ? a[JJ][lane] : a[KK][lane];
+        a[JJ][lane] = lo;
+        a[KK][lane] = hi;
+        for (int axis = 0; axis < 3; ++axis) {
+            const float vj = v[3 * J + axis][lane], vk = v[3 * K + axis][lane];
+            v[3 * J + axis][lane] = swap ? vk : vj;
+            v[3 * K + axis][lane] = swap ? vj : vk;
+        }
+    }
+}
+
+} // namespace
+
+AME_SIMD_CLONES
+void solveSymmetricEigen3(
+    size_t count,
+    const float* const packed[6],
+    float* const eigenvalues[3],
+    float* const eigenvectors[9]
+) {
+    for (size_t base = 0; base < count; base += kLanes) {
+        const int lanes = static_cast<int>(std::min<size_t>(kLanes, count - base));
+        
+        // Padding lanes hold the identity, which is already diagonal
+        float a[6][kLanes];
+        float v[9][kLanes];
+        for (int c = 0; c < 6; ++c) {
+            for (int lane = 0; lane < kLanes; ++lane) {
+                a[c][lane] = lane < lanes ? packed[c][base + lane] : (c == 0 || c == 3 || c == 5 ? 1.0f : 0.0f);
+            }
+        }
+        for (int c = 0; c < 9; ++c) {
+            for (int lane = 0; lane < kLanes; ++lane) {
+                v[c][lane] = (c == 0 || c == 4 || c == 8) ? 1.0f : 0.0f;
+            }
+        }
+        
+        // Scale each matrix to unit max entry. The off-diagonal terms shrink
+        // quadratically per sweep and would otherwise reach denormals, which
+        // are very slow, and large covariances would overflow when squared.
+        float scale[kLanes];
+#pragma GCC unroll 1
+        for (int lane = 0; lane < kLanes; ++lane) {
+            float max_entry = 0.0f;
+            for (int c = 0; c < 6; ++c) {
+                max_entry = std::max(max_entry, std::abs(a[c][lane]));
+            }
+            scale[lane] = max_entry;
+            const float inv_scale = 1.0f / std::max(max_entry, std::numeric_limits<float>::min());
+            for (int c = 0; c < 6; ++c) {
+                a[c][lane] *= inv_scale;
+            }
+        }
+        
+        // Stop once every lane's off-diagonal mass is at float precision
+        // relative to the (now unit-sized) matrix; 3x3 cyclic Jacobi
+        // converges in a few sweeps. Remainders too small to matter are
+        // flushed so later sweeps never multiply them into denormals.
+        for (int sweep = 0; sweep < kMaxSweeps; ++sweep) {
+            jacobiRotate<0, 1>(a, v);
+            jacobiRotate<0, 2>(a, v);
+            jacobiRotate<1, 2>(a, v);
+            
+            int unconverged = 0;
+#pragma GCC unroll 1
+            for (int lane = 0; lane < kLanes; ++lane) {
+                float off = 0.0f;
+                for (int c : {1, 2, 4}) {
+                    a[c][lane] = std::abs(a[c][lane]) < kNegligible ? 0.0f : a[c][lane];
+                    off += a[c][lane] * a[c][lane];
+                }
+                unconverged += off > kConvergedOffDiagonal;
+            }
+            if (unconverged == 0) {
+                break;
+            }
+        }
+        
+        sortPair<0, 1>(a, v);
+        sortPair<1, 2>(a, v);
+        sortPair<0, 1>(a, v);
+        
+        for (int lane = 0; lane < lanes; ++lane) {
+            eigenvalues[0][base + lane] = a[0][lane] * scale[lane];
+            eigenvalues[1][base + lane] = a[3][lane] * scale[lane];
+            eigenvalues[2][base + lane] = a[5][lane] * scale[lane];
+        }
+        for (int c = 0; c < 9; ++c) {
+            for (int lane = 0; lane < lanes; ++lane) {
+                eigenvectors[c][base + lane] = v[c][lane];
+            }
+        }
+    }
+}
+
+void solveSymmetricEigen3(const float packed[6], float eigenvalues[3], float eigenvectors[9]) {
+    const float* packed_columns[6];
+    float* eigenvalue_columns[3];
+    float* eigenvector_columns[9];
+    for (int c = 0; c < 6; ++c) {
+        packed_columns[c] = packed + c;
+    }
+    for (int k = 0; k < 3; ++k) {
+        eigenvalue_columns[k] = eigenvalues + k;
+    }
+    for (int c = 0; c < 9; ++c) {
+        eigenvector_columns[c] = eigenvectors + c;
+    }
+    solveSymmetricEigen3(1, packed_columns, eigenvalue_columns, eigenvector_columns);
+}
+
+} // namespace AmeScanner
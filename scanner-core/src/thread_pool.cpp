@@ -0,0 +1,141 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+
+namespace AmeScanner {
+
+namespace {
+
+thread_local bool t_in_pool = false;
+thread_local size_t t_worker_id = 0;
+
+std::mutex g_global_mutex;
+std::unique_ptr<ThreadPool> g_global_pool;
+
+// AME_NUM_THREADS, read once; 0 if unset or not a positive number
+size_t environmentThreadCount() {
+    static const size_t count = [] {
+        const char* value = std::getenv("AME_NUM_THREADS");
+        if (value == nullptr) {
+            return size_t(0);
+        }
+        char* end = nullptr;
+        long parsed = std::strtol(value, &end, 10);
+        return end != value && *end == '\0' && parsed > 0 ? static_cast<size_t>(parsed) : size_t(0);
+    }();
+    return count;
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    
+    workers_.reserve(num_threads - 1);
+    for (size_t i = 1; i < num_threads; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    std::lock_guard<std::mutex> lock(g_global_mutex);
+    if (!g_global_pool) {
+        g_global_pool = std::make_unique<ThreadPool>(environmentThreadCount());
+    }
+    return *g_global_pool;
+}
+
+void ThreadPool::setGlobalThreadCount(size_t num_threads) {
+    std::lock_guard<std::mutex> lock(g_global_mutex);
+    g_global_pool.reset();
+    g_global_pool = std::make_unique<ThreadPool>(num_threads > 0 ? num_threads : environmentThreadCount());
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(1, grain);
+    
+    // Nested, single-threaded or single-chunk loops run inline
+    if (t_in_pool || workers_.empty() || count <= grain) {
+        bool was_in_pool = t_in_pool;
+        t_in_pool = true;
+        for (size_t begin = 0; begin < count; begin += grain) {
+            body(begin, std::min(count, begin + grain), t_worker_id);
+        }
+        t_in_pool = was_in_pool;
+        return;
+    }
+    
+    std::lock_guard<std::mutex> job_lock(job_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body_ = &body;
+        count_ = count;
+        grain_ = grain;
+        next_.store(0, std::memory_order_relaxed);
+        active_ = workers_.size();
+        ++generation_;
+    }
+    wake_cv_.notify_all();
+    
+    t_in_pool = true;
+    t_worker_id = 0;
+    runChunks(0);
+    t_in_pool = false;
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return active_ == 0; });
+    body_ = nullptr;
+}
+
+void ThreadPool::workerLoop(size_t worker_id) {
+    t_in_pool = true;
+    t_worker_id = worker_id;
+    
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_cv_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+            if (stop_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+        
+        runChunks(worker_id);
+        
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            done_cv_.notify_all();
+        }
+    }
+}
+
+void ThreadPool::runChunks(size_t worker_id) {
+    while (true) {
+        size_t begin = next_.fetch_add(grain_, std::memory_order_relaxed);
+        if (begin >= count_) {
+            return;
+        }
+        (*body_)(begin, std::min(count_, begin + grain_), worker_id);
+    }
+}
+
+} // namespace AmeScanner
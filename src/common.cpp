@@ -1,4 +1,5 @@
 #include "common.h"
+#include "symmetric_eigen.h"
 #include <cmath>
 
 // Vector3 类实现
@@ -90,21 +91,20 @@ void transposeMatrix(RotationMatrix m, RotationMatrix result) {
 
 // 求解 3x3 对称矩阵的特征值和特征向量
 void solveEigenvalues(const float matrix[3][3], float eigenvalues[3], float eigenvectors[3][3]) {
-    // 对于 3x3 对称矩阵，我们可以使用特征多项式求解
-    // 这里使用简化的方法，实际应用中可能需要更 robust 的算法
-
-    // 初始化特征值为对角线元素
-    eigenvalues[0] = matrix[0][0];
-    eigenvalues[1] = matrix[1][1];
-    eigenvalues[2] = matrix[2][2];
-
-    // 初始化特征向量为单位矩阵
-    eigenvectors[0][0] = 1; eigenvectors[0][1] = 0; eigenvectors[0][2] = 0;
-    eigenvectors[1][0] = 0; eigenvectors[1][1] = 1; eigenvectors[1][2] = 0;
-    eigenvectors[2][0] = 0; eigenvectors[2][1] = 0; eigenvectors[2][2] = 1;
-
-    // 注意：这是一个简化实现，实际应用中需要使用更 accurate 的特征值分解算法
-    // 例如，可以使用 QR 算法或 Jacobi 算法
+    // 使用 scanner-core 的批量 Jacobi 求解器（单个矩阵）
+    float packed[6] = {
+        matrix[0][0], matrix[0][1], matrix[0][2],
+        matrix[1][1], matrix[1][2], matrix[2][2]
+    };
+    float vectors[9];
+    AmeScanner::solveSymmetricEigen3(packed, eigenvalues, vectors);
+
+    // 特征向量按列排列：eigenvectors[k][i] 是第 i 个特征向量的第 k 个分量
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 3; k++) {
+            eigenvectors[k][i] = vectors[3 * i + k];
+        }
+    }
 }
 
 // 按特征值排序特征向量
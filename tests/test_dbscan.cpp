@@ -0,0 +1,417 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <map>
+#include <string>
+#include <numeric>
+#include <functional>
+#include <Eigen/Geometry>
+#include "dbscan.h"
+
+namespace {
+
+std::vector<AmeScanner::Gaussian> makeClusteredScene(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> spread(0.0f, 0.08f);
+    std::uniform_real_distribution<float> uniform(-2.0f, 2.0f);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int c = 0; c < 6; ++c) {
+        Eigen::Vector3f center(uniform(rng), uniform(rng), uniform(rng));
+        for (int i = 0; i < 300; ++i) {
+            gaussians.emplace_back(
+                center + Eigen::Vector3f(spread(rng), spread(rng), spread(rng)),
+                Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+                0.9f,
+                Eigen::Vector3f(0.02f, 0.02f, 0.02f),
+                Eigen::Quaternionf::Identity()
+            );
+        }
+    }
+    
+    // Sparse floaters
+    for (int i = 0; i < 200; ++i) {
+        gaussians.emplace_back(
+            Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng)),
+            Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+            0.05f,
+            Eigen::Vector3f(0.02f, 0.02f, 0.02f),
+            Eigen::Quaternionf::Identity()
+        );
+    }
+    
+    std::shuffle(gaussians.begin(), gaussians.end(), rng);
+    return gaussians;
+}
+
+// Labels describe the same partition up to a renaming of cluster ids
+bool samePartition(const std::vector<int32_t>& a, const std::vector<int32_t>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    std::map<int32_t, int32_t> a_to_b, b_to_a;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if ((a[i] < 0) != (b[i] < 0)) {
+            return false;
+        }
+        if (a[i] < 0) {
+            continue;
+        }
+        auto [it_a, new_a] = a_to_b.emplace(a[i], b[i]);
+        auto [it_b, new_b] = b_to_a.emplace(b[i], a[i]);
+        if (it_a->second != b[i] || it_b->second != a[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Checks labels against DBSCAN over an explicit neighbor graph: core points
+// linked through neighbors share a cluster, border points take the cluster
+// of one of their core neighbors and everything else is noise. Returns an
+// empty string on a match, else the first mismatch.
+std::string checkAgainstReference(const std::vector<std::vector<uint32_t>>& neighbors,
+                                  const std::vector<uint8_t>& core,
+                                  const std::vector<int32_t>& labels) {
+    const size_t n = neighbors.size();
+    std::vector<uint32_t> parent(n);
+    std::iota(parent.begin(), parent.end(), 0u);
+    std::function<uint32_t(uint32_t)> find = [&](uint32_t x) {
+        return parent[x] == x ? x : parent[x] = find(parent[x]);
+    };
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j : neighbors[i]) {
+            if (core[i] && core[j]) {
+                parent[find(i)] = find(j);
+            }
+        }
+    }
+    
+    std::map<uint32_t, int32_t> component_to_label;
+    std::map<int32_t, uint32_t> label_to_component;
+    for (uint32_t i = 0; i < n; ++i) {
+        if (!core[i]) {
+            continue;
+        }
+        if (labels[i] < 0) {
+            return "core point " + std::to_string(i) + " is not clustered";
+        }
+        auto [it_c, new_c] = component_to_label.emplace(find(i), labels[i]);
+        auto [it_l, new_l] = label_to_component.emplace(labels[i], find(i));
+        if (it_c->second != labels[i] || it_l->second != find(i)) {
+            return "core point " + std::to_string(i) + " is in the wrong cluster";
+        }
+    }
+    for (uint32_t i = 0; i < n; ++i) {
+        if (core[i]) {
+            continue;
+        }
+        bool border = false, joined = false;
+        for (uint32_t j : neighbors[i]) {
+            if (core[j]) {
+                border = true;
+                joined = joined || labels[j] == labels[i];
+            }
+        }
+        if (border ? !joined : labels[i] != AmeScanner::DBSCAN::kNoise) {
+            return "point " + std::to_string(i) + " has the wrong border or noise label";
+        }
+    }
+    return "";
+}
+
+// Chains of elongated splats spaced wider than eps along their long axis,
+// close enough that neighbors sit inside each other's 3-sigma ellipsoid,
+// among round clutter
+std::vector<AmeScanner::Gaussian> makeRodScene(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> long_scale(0.02f, 0.06f);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int r = 0; r < 6; ++r) {
+        Eigen::Quaternionf rotation(Eigen::Vector4f(normal(rng), normal(rng), normal(rng), normal(rng)).normalized());
+        Eigen::Vector3f axis = rotation * Eigen::Vector3f::UnitX();
+        Eigen::Vector3f start(uniform(rng), uniform(rng), uniform(rng));
+        for (int i = 0; i < 20; ++i) {
+            gaussians.emplace_back(
+                start + (0.1f * i) * axis,
+                Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+                0.9f,
+                Eigen::Vector3f(long_scale(rng), 0.01f, 0.01f),
+                rotation
+            );
+        }
+    }
+    for (int i = 0; i < 300; ++i) {
+        gaussians.emplace_back(
+            Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng)),
+            Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+            0.9f,
+            Eigen::Vector3f(0.01f, 0.01f, 0.01f),
+            Eigen::Quaternionf::Identity()
+        );
+    }
+    
+    std::shuffle(gaussians.begin(), gaussians.end(), rng);
+    return gaussians;
+}
+
+// Brute-force anisotropic neighbors: within eps, or one center inside the
+// other's ellipsoid and within the larger capped bounding radius
+std::vector<std::vector<uint32_t>> anisotropicNeighbors(const std::vector<AmeScanner::Gaussian>& gaussians,
+                                                        float eps, float sigmas, float radius_cap) {
+    const size_t n = gaussians.size();
+    std::vector<Eigen::Matrix3f> inv_cov(n);
+    std::vector<float> radius(n);
+    for (size_t i = 0; i < n; ++i) {
+        Eigen::Matrix3f R = gaussians[i].getRotation().toRotationMatrix();
+        Eigen::Vector3f scale = gaussians[i].getScale();
+        inv_cov[i] = R * scale.cwiseProduct(scale).cwiseInverse().asDiagonal() * R.transpose();
+        radius[i] = std::min(sigmas * scale.maxCoeff(), radius_cap);
+    }
+    
+    std::vector<std::vector<uint32_t>> neighbors(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        for (uint32_t j = 0; j < n; ++j) {
+            Eigen::Vector3f d = gaussians[j].getPosition() - gaussians[i].getPosition();
+            float dist = d.norm();
+            float mahalanobis_sq = std::min(d.dot(inv_cov[i] * d), d.dot(inv_cov[j] * d));
+            bool inside = dist <= std::max(radius[i], radius[j]) && mahalanobis_sq <= sigmas * sigmas;
+            if (i != j && (dist <= eps || inside)) {
+                neighbors[i].push_back(j);
+            }
+        }
+    }
+    return neighbors;
+}
+
+} // namespace
+
+bool testBatchClustering() {
+    std::cout << "Testing batch clustering..." << std::endl;
+    
+    auto gaussians = makeClusteredScene(7);
+    AmeScanner::DBSCAN dbscan(0.06f, 6);
+    auto clusters = dbscan.cluster(gaussians);
+    
+    size_t clustered = 0;
+    for (const auto& cluster : clusters) {
+        clustered += cluster.size();
+    }
+    
+    if (clustered + dbscan.getNumNoise() != gaussians.size()) {
+        std::cout << "✗ Clustered and noise points do not add up to the input size" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Found " << clusters.size() << " clusters and " << dbscan.getNumNoise() << " noise points" << std::endl;
+    return true;
+}
+
+bool testIncrementalInsert() {
+    std::cout << "\nTesting incremental insert..." << std::endl;
+    
+    auto gaussians = makeClusteredScene(11);
+    
+    AmeScanner::DBSCAN full(0.06f, 6);
+    full.cluster(gaussians);
+    
+    AmeScanner::DBSCAN incremental(0.06f, 6);
+    std::vector<AmeScanner::Gaussian> initial(gaussians.begin(), gaussians.begin() + 600);
+    incremental.cluster(initial);
+    for (size_t start = 600; start < gaussians.size(); start += 250) {
+        size_t count = std::min<size_t>(250, gaussians.size() - start);
+        incremental.insert(std::span<const AmeScanner::Gaussian>(gaussians.data() + start, count));
+    }
+    
+    if (incremental.getNumClusters() != full.getNumClusters()) {
+        std::cout << "✗ Incremental run found " << incremental.getNumClusters()
+                  << " clusters, full run found " << full.getNumClusters() << std::endl;
+        return false;
+    }
+    
+    if (!samePartition(full.getLabels(), incremental.getLabels())) {
+        std::cout << "✗ Incremental labels differ from a full re-cluster" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Incremental insert matches full re-cluster (" << incremental.getNumClusters() << " clusters)" << std::endl;
+    return true;
+}
+
+bool testOpacityFloor() {
+    std::cout << "\nTesting opacity floor..." << std::endl;
+    
+    auto gaussians = makeClusteredScene(13);
+    
+    AmeScanner::DBSCAN unfiltered(0.06f, 6);
+    unfiltered.cluster(gaussians);
+    
+    AmeScanner::DBSCAN filtered(0.06f, 6);
+    filtered.setOpacityFloor(0.1f);
+    filtered.cluster(gaussians);
+    
+    size_t expected_filtered = 0;
+    for (size_t i = 0; i < gaussians.size(); ++i) {
+        bool below_floor = gaussians[i].getOpacity() < 0.1f;
+        expected_filtered += below_floor ? 1 : 0;
+        if (below_floor != (filtered.getLabels()[i] == AmeScanner::DBSCAN::kFiltered)) {
+            std::cout << "✗ Point " << i << " has the wrong filtered label" << std::endl;
+            return false;
+        }
+    }
+    
+    if (static_cast<size_t>(filtered.getNumFiltered()) != expected_filtered) {
+        std::cout << "✗ Expected " << expected_filtered << " filtered points, got " << filtered.getNumFiltered() << std::endl;
+        return false;
+    }
+    
+    if (filtered.getNumClusters() != unfiltered.getNumClusters()) {
+        std::cout << "✗ Filtering floaters changed the number of clusters" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Filtered " << filtered.getNumFiltered() << " floaters, " << filtered.getNumClusters() << " clusters kept" << std::endl;
+    return true;
+}
+
+bool testAnisotropicClustering() {
+    std::cout << "\nTesting anisotropic clustering..." << std::endl;
+    
+    auto gaussians = makeRodScene(17);
+    const float eps = 0.04f, sigmas = 3.0f;
+    const int min_pts = 2;
+    
+    // Capped at 4 * eps the rods still link up; a 0.08 cap is shorter than
+    // the spacing and breaks them apart
+    for (float cap : {0.0f, 0.08f}) {
+        auto neighbors = anisotropicNeighbors(gaussians, eps, sigmas, cap > 0.0f ? cap : 4.0f * eps);
+        std::vector<uint8_t> core(gaussians.size());
+        for (size_t i = 0; i < gaussians.size(); ++i) {
+            core[i] = neighbors[i].size() >= static_cast<size_t>(min_pts);
+        }
+        
+        AmeScanner::DBSCAN batch(eps, min_pts);
+        batch.setDistanceMode(AmeScanner::DBSCAN::DistanceMode::Anisotropic);
+        batch.setMahalanobisThreshold(sigmas);
+        batch.setMaxSplatRadius(cap);
+        batch.cluster(gaussians);
+        
+        AmeScanner::DBSCAN incremental(eps, min_pts);
+        incremental.setDistanceMode(AmeScanner::DBSCAN::DistanceMode::Anisotropic);
+        incremental.setMahalanobisThreshold(sigmas);
+        incremental.setMaxSplatRadius(cap);
+        for (size_t start = 0; start < gaussians.size(); start += 100) {
+            size_t count = std::min<size_t>(100, gaussians.size() - start);
+            incremental.insert(std::span<const AmeScanner::Gaussian>(gaussians.data() + start, count));
+        }
+        
+        for (const auto* dbscan : {&batch, &incremental}) {
+            std::string error = checkAgainstReference(neighbors, core, dbscan->getLabels());
+            if (!error.empty()) {
+                std::cout << "✗ " << (dbscan == &batch ? "cluster()" : "insert()") << " with cap " << cap
+                          << ": " << error << std::endl;
+                return false;
+            }
+        }
+        
+        // Rod spacing exceeds eps and the clutter is too sparse to cluster,
+        // so every cluster comes from the ellipsoid test
+        if ((batch.getNumClusters() > 0) != (cap == 0.0f)) {
+            std::cout << "✗ Found " << batch.getNumClusters() << " clusters with cap " << cap << std::endl;
+            return false;
+        }
+        std::cout << "✓ Cap " << cap << ": " << batch.getNumClusters() << " clusters, "
+                  << batch.getNumNoise() << " noise points, matching the brute-force reference" << std::endl;
+    }
+    return true;
+}
+
+bool testOpacityMassWeighting() {
+    std::cout << "\nTesting opacity mass weighting..." << std::endl;
+    
+    // Isolated tight groups mixing a few opaque and many faint gaussians, so
+    // a point's neighbor count and summed opacity disagree on core status
+    std::mt19937 rng(19);
+    std::uniform_int_distribution<int> num_opaque(0, 4), num_faint(0, 15);
+    std::uniform_real_distribution<float> jitter(-0.02f, 0.02f);
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int g = 0; g < 60; ++g) {
+        Eigen::Vector3f center(g % 5, (g / 5) % 4, g / 20);
+        int opaque = num_opaque(rng), faint = num_faint(rng);
+        for (int i = 0; i < opaque + faint; ++i) {
+            gaussians.emplace_back(
+                center + Eigen::Vector3f(jitter(rng), jitter(rng), jitter(rng)),
+                Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+                i < opaque ? 0.8f : 0.06f,
+                Eigen::Vector3f(0.01f, 0.01f, 0.01f),
+                Eigen::Quaternionf::Identity()
+            );
+        }
+    }
+    std::shuffle(gaussians.begin(), gaussians.end(), rng);
+    
+    const float eps = 0.06f, min_mass = 1.5f;
+    const size_t n = gaussians.size();
+    std::vector<std::vector<uint32_t>> neighbors(n);
+    std::vector<uint8_t> core(n);
+    size_t count_core_disagreements = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        float mass = 0.0f;
+        for (uint32_t j = 0; j < n; ++j) {
+            if (i != j && (gaussians[j].getPosition() - gaussians[i].getPosition()).norm() <= eps) {
+                neighbors[i].push_back(j);
+                mass += gaussians[j].getOpacity();
+            }
+        }
+        core[i] = mass >= min_mass;
+        count_core_disagreements += core[i] != (neighbors[i].size() >= 3);
+    }
+    
+    AmeScanner::DBSCAN batch(eps, 3);
+    batch.setNeighborWeighting(AmeScanner::DBSCAN::NeighborWeighting::OpacityMass);
+    batch.setMinMass(min_mass);
+    batch.cluster(gaussians);
+    
+    AmeScanner::DBSCAN incremental(eps, 3);
+    incremental.setNeighborWeighting(AmeScanner::DBSCAN::NeighborWeighting::OpacityMass);
+    incremental.setMinMass(min_mass);
+    for (size_t start = 0; start < n; start += 64) {
+        size_t count = std::min<size_t>(64, n - start);
+        incremental.insert(std::span<const AmeScanner::Gaussian>(gaussians.data() + start, count));
+    }
+    
+    std::string error = checkAgainstReference(neighbors, core, batch.getLabels());
+    if (!error.empty()) {
+        std::cout << "✗ cluster(): " << error << std::endl;
+        return false;
+    }
+    if (!samePartition(batch.getLabels(), incremental.getLabels())) {
+        std::cout << "✗ Incremental labels differ from a full cluster() run" << std::endl;
+        return false;
+    }
+    if (count_core_disagreements == 0) {
+        std::cout << "✗ Scene does not separate mass from count weighting" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << batch.getNumClusters() << " clusters, " << count_core_disagreements
+              << " points whose core status depends on opacity mass" << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== DBSCAN Test ===" << std::endl;
+    
+    bool passed = testBatchClustering();
+    passed = testIncrementalInsert() && passed;
+    passed = testOpacityFloor() && passed;
+    passed = testOpacityMassWeighting() && passed;
+    passed = testAnisotropicClustering() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,598 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Geometry>
+#include <filesystem>
+#include <fstream>
+#include "density_analyzer.h"
+#include "mapped_density_field.h"
+
+namespace {
+
+std::vector<AmeScanner::Gaussian> makeScene(unsigned seed, int count) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.03f, 0.12f);
+    std::uniform_real_distribution<float> opacity(0.2f, 1.0f);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int i = 0; i < count; ++i) {
+        gaussians.emplace_back(
+            Eigen::Vector3f(position(rng), position(rng), position(rng)),
+            Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+            opacity(rng),
+            Eigen::Vector3f(scale(rng), scale(rng), scale(rng)),
+            Eigen::Quaternionf::UnitRandom()
+        );
+    }
+    return gaussians;
+}
+
+} // namespace
+
+bool testDensityFieldMatchesPointEvaluation() {
+    std::cout << "Testing density field against per-point evaluation..." << std::endl;
+    
+    auto gaussians = makeScene(3, 200);
+    AmeScanner::DensityAnalyzer analyzer(0.1f);
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto field = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    
+    float max_error = 0.0f;
+    const float tolerance = 1e-4f;
+    std::mt19937 rng(5);
+    for (int sample = 0; sample < 500; ++sample) {
+        Eigen::Vector3i voxel(rng() % grid_dims.x(), rng() % grid_dims.y(), rng() % grid_dims.z());
+        Eigen::Vector3f center = min_bounds + (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * 0.1f;
+        size_t linear = voxel.x() + static_cast<size_t>(voxel.y()) * grid_dims.x() +
+                        static_cast<size_t>(voxel.z()) * grid_dims.x() * grid_dims.y();
+        
+        // Brute-force reference with the same 3 sigma cutoff
+        float expected = 0.0f;
+        for (const auto& gaussian : gaussians) {
+            float sigma = gaussian.getScale().mean();
+            float dist = (center - gaussian.getPosition()).norm();
+            if (dist <= 3.0f * sigma) {
+                expected += gaussian.getOpacity() * std::exp(-0.5f * dist * dist / (sigma * sigma));
+            }
+        }
+        max_error = std::max(max_error, std::abs(field[linear] - expected));
+    }
+    
+    if (max_error > tolerance) {
+        std::cout << "✗ Max voxel error " << max_error << " exceeds " << tolerance << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Max voxel error " << max_error << " (tolerance " << tolerance << ")" << std::endl;
+    return true;
+}
+
+bool testFastExpAccuracy() {
+    std::cout << "Testing fast exp accuracy..." << std::endl;
+    
+    double max_rel_error = 0.0;
+    const double tolerance = 3e-7;
+    for (int i = 0; i <= 870000; ++i) {
+        float x = -static_cast<float>(i) * 1e-4f;
+        double expected = std::exp(static_cast<double>(x));
+        double rel_error = std::abs(AmeScanner::fastExp(x) - expected) / expected;
+        max_rel_error = std::max(max_rel_error, rel_error);
+    }
+    
+    if (max_rel_error > tolerance) {
+        std::cout << "✗ Max relative error " << max_rel_error << " exceeds " << tolerance << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Max relative error " << max_rel_error << " on [-87, 0]" << std::endl;
+    return true;
+}
+
+bool testPointDensityMatchesField() {
+    std::cout << "Testing point density against the field..." << std::endl;
+    
+    // 37 gaussians leaves a partial SIMD batch
+    auto gaussians = makeScene(11, 37);
+    AmeScanner::DensityAnalyzer analyzer(0.1f);
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto field = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    
+    std::vector<Eigen::Vector3f> centers;
+    std::vector<size_t> linear;
+    for (int z = 0; z < grid_dims.z(); z += 3) {
+        for (int y = 0; y < grid_dims.y(); y += 3) {
+            for (int x = 0; x < grid_dims.x(); x += 3) {
+                centers.push_back(min_bounds + (Eigen::Vector3f(x, y, z) + Eigen::Vector3f::Constant(0.5f)) * 0.1f);
+                linear.push_back(x + static_cast<size_t>(y) * grid_dims.x() +
+                                 static_cast<size_t>(z) * grid_dims.x() * grid_dims.y());
+            }
+        }
+    }
+    auto densities = analyzer.computeDensityAtPoints(gaussians, centers);
+    
+    float max_error = std::abs(analyzer.computeDensityAtPoint(gaussians, centers[0]) - densities[0]);
+    for (size_t i = 0; i < centers.size(); ++i) {
+        max_error = std::max(max_error, std::abs(densities[i] - field[linear[i]]));
+    }
+    
+    if (max_error > 1e-4f) {
+        std::cout << "✗ Max point/field difference " << max_error << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Max point/field difference " << max_error << std::endl;
+    return true;
+}
+
+bool testSparseFieldMatchesDense() {
+    std::cout << "Testing sparse field against the dense grid..." << std::endl;
+    
+    auto gaussians = makeScene(7, 300);
+    AmeScanner::DensityAnalyzer analyzer(0.1f);
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto dense = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    auto sparse = analyzer.computeSparseDensityField(gaussians);
+    
+    float max_error = 0.0f;
+    for (int z = 0; z < grid_dims.z(); ++z) {
+        for (int y = 0; y < grid_dims.y(); ++y) {
+            for (int x = 0; x < grid_dims.x(); ++x) {
+                size_t linear = x + static_cast<size_t>(y) * grid_dims.x() +
+                                static_cast<size_t>(z) * grid_dims.x() * grid_dims.y();
+                max_error = std::max(max_error, std::abs(sparse.getValue(Eigen::Vector3i(x, y, z)) - dense[linear]));
+            }
+        }
+    }
+    if (max_error > 0.0f) {
+        std::cout << "✗ Sparse and dense fields differ by " << max_error << std::endl;
+        return false;
+    }
+    
+    size_t dense_regions = analyzer.findDenseRegions(dense, min_bounds, grid_dims, 0.5f).size();
+    size_t sparse_regions = analyzer.findDenseRegions(sparse, 0.5f).size();
+    if (dense_regions != sparse_regions) {
+        std::cout << "✗ Dense regions: " << dense_regions << " dense vs " << sparse_regions << " sparse" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Sparse field matches dense grid (" << sparse.getNumBricks() << " bricks, "
+              << sparse_regions << " dense voxels)" << std::endl;
+    return true;
+}
+
+bool testSparseFieldWithOutlier() {
+    std::cout << "Testing sparse field with a distant outlier..." << std::endl;
+    
+    // The padded bounding box is ~10^13 voxels at this resolution
+    auto gaussians = makeScene(9, 100);
+    gaussians.emplace_back(
+        Eigen::Vector3f(500.0f, 500.0f, 500.0f),
+        Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+        1.0f,
+        Eigen::Vector3f(0.05f, 0.05f, 0.05f),
+        Eigen::Quaternionf::Identity()
+    );
+    AmeScanner::DensityAnalyzer analyzer(0.02f);
+    auto sparse = analyzer.computeSparseDensityField(gaussians);
+    
+    const size_t limit = 64 * 1024 * 1024;
+    if (sparse.getMemoryUsage() > limit) {
+        std::cout << "✗ Sparse field uses " << sparse.getMemoryUsage() << " bytes" << std::endl;
+        return false;
+    }
+    
+    Eigen::Vector3i outlier_voxel = ((Eigen::Vector3f(500.0f, 500.0f, 500.0f) - sparse.getOrigin()) / 0.02f).cast<int>();
+    if (sparse.getValue(outlier_voxel) < 0.5f) {
+        std::cout << "✗ Outlier density missing: " << sparse.getValue(outlier_voxel) << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << sparse.getNumBricks() << " bricks in " << sparse.getMemoryUsage() / 1024 << " KB" << std::endl;
+    return true;
+}
+
+bool testStatisticsMatchSortedField() {
+    std::cout << "Testing streaming statistics against a sorted copy..." << std::endl;
+    
+    auto gaussians = makeScene(13, 400);
+    AmeScanner::DensityAnalyzer analyzer(0.05f);
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto field = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    const auto& stats = analyzer.getStatistics();
+    
+    std::vector<float> sorted(field);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float value : field) {
+        sum += value;
+    }
+    double mean = sum / field.size();
+    double sum_sq = 0.0;
+    for (float value : field) {
+        sum_sq += (value - mean) * (value - mean);
+    }
+    double std_dev = std::sqrt(sum_sq / field.size());
+    
+    bool passed = true;
+    auto check = [&](const char* name, double actual, double expected, double tolerance) {
+        if (std::abs(actual - expected) > tolerance) {
+            std::cout << "✗ " << name << ": " << actual << " vs " << expected << std::endl;
+            passed = false;
+        }
+    };
+    check("min", stats.min_density, sorted.front(), 0.0);
+    check("max", stats.max_density, sorted.back(), 0.0);
+    check("mean", stats.mean_density, mean, 1e-6 * sorted.back());
+    check("std dev", stats.std_dev_density, std_dev, 1e-6 * sorted.back());
+    
+    // Histogram bins are 1/128 of an octave wide
+    for (float q : {0.1f, 0.5f, 0.75f, 0.9f, 0.99f}) {
+        double expected = sorted[static_cast<size_t>(q * (sorted.size() - 1))];
+        check("percentile", analyzer.getPercentile(q), expected, expected / 64.0 + 1e-7);
+    }
+    
+    if (passed) {
+        std::cout << "✓ Min/max/mean/std dev exact, percentiles within one bin (median "
+                  << stats.median_density << ", p99 " << stats.p99_density << ")" << std::endl;
+    }
+    return passed;
+}
+
+bool testConnectedRegionsMatchFloodFill() {
+    std::cout << "Testing dense region labeling against a flood fill..." << std::endl;
+    
+    auto gaussians = makeScene(17, 250);
+    AmeScanner::DensityAnalyzer analyzer(0.05f);
+    const float threshold = 0.3f;
+    
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto field = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    
+    // Reference: breadth-first flood fill over 6-neighbours
+    const size_t num_voxels = field.size();
+    std::vector<int32_t> expected(num_voxels, -1);
+    std::vector<size_t> expected_counts;
+    const int64_t strides[3] = {1, grid_dims.x(), static_cast<int64_t>(grid_dims.x()) * grid_dims.y()};
+    for (size_t seed = 0; seed < num_voxels; ++seed) {
+        if (field[seed] < threshold || expected[seed] >= 0) {
+            continue;
+        }
+        int32_t label = static_cast<int32_t>(expected_counts.size());
+        expected_counts.push_back(0);
+        std::vector<size_t> queue = {seed};
+        expected[seed] = label;
+        while (!queue.empty()) {
+            size_t voxel = queue.back();
+            queue.pop_back();
+            expected_counts[label]++;
+            int coords[3] = {
+                static_cast<int>(voxel % grid_dims.x()),
+                static_cast<int>((voxel / grid_dims.x()) % grid_dims.y()),
+                static_cast<int>(voxel / strides[2])
+            };
+            for (int axis = 0; axis < 3; ++axis) {
+                for (int step : {-1, 1}) {
+                    int c = coords[axis] + step;
+                    if (c < 0 || c >= grid_dims[axis]) {
+                        continue;
+                    }
+                    size_t next = voxel + step * strides[axis];
+                    if (field[next] >= threshold && expected[next] < 0) {
+                        expected[next] = label;
+                        queue.push_back(next);
+                    }
+                }
+            }
+        }
+    }
+    
+    std::vector<int32_t> labels;
+    auto regions = analyzer.labelDenseRegions(field, min_bounds, grid_dims, threshold, &labels);
+    if (regions.size() != expected_counts.size()) {
+        std::cout << "✗ " << regions.size() << " regions, flood fill found " << expected_counts.size() << std::endl;
+        return false;
+    }
+    
+    // Same partition: labels must map one-to-one onto the reference
+    std::vector<int32_t> mapping(regions.size(), -1);
+    for (size_t i = 0; i < num_voxels; ++i) {
+        if ((labels[i] < 0) != (expected[i] < 0)) {
+            std::cout << "✗ Voxel " << i << " labeled inconsistently" << std::endl;
+            return false;
+        }
+        if (labels[i] < 0) {
+            continue;
+        }
+        if (mapping[labels[i]] < 0) {
+            mapping[labels[i]] = expected[i];
+        } else if (mapping[labels[i]] != expected[i]) {
+            std::cout << "✗ Region " << labels[i] << " merges separate components" << std::endl;
+            return false;
+        }
+    }
+    
+    float total_mass = 0.0f;
+    for (size_t r = 0; r < regions.size(); ++r) {
+        if (regions[r].voxel_count != expected_counts[mapping[r]]) {
+            std::cout << "✗ Region " << r << " has " << regions[r].voxel_count << " voxels" << std::endl;
+            return false;
+        }
+        if (!(regions[r].centroid.array() >= regions[r].min_bounds.array()).all() ||
+            !(regions[r].centroid.array() <= regions[r].max_bounds.array()).all()) {
+            std::cout << "✗ Region " << r << " centroid outside its bounds" << std::endl;
+            return false;
+        }
+        total_mass += regions[r].mass;
+    }
+    
+    float expected_mass = 0.0f;
+    for (size_t i = 0; i < num_voxels; ++i) {
+        if (field[i] >= threshold) {
+            expected_mass += field[i] * 0.05f * 0.05f * 0.05f;
+        }
+    }
+    if (std::abs(total_mass - expected_mass) > 1e-4f * expected_mass) {
+        std::cout << "✗ Total mass " << total_mass << " vs " << expected_mass << std::endl;
+        return false;
+    }
+    
+    // The sparse field labels the same regions
+    auto sparse = analyzer.computeSparseDensityField(gaussians);
+    auto sparse_regions = analyzer.labelDenseRegions(sparse, threshold);
+    if (sparse_regions.size() != regions.size()) {
+        std::cout << "✗ Sparse labeling found " << sparse_regions.size() << " regions" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << regions.size() << " regions match the flood fill" << std::endl;
+    return true;
+}
+
+bool testPyramidPrunesBricks() {
+    std::cout << "Testing density pyramid queries..." << std::endl;
+    
+    auto gaussians = makeScene(19, 600);
+    AmeScanner::DensityAnalyzer analyzer(0.02f);
+    auto field = analyzer.computeSparseDensityField(gaussians);
+    const auto& pyramid = field.getPyramid();
+    
+    if (pyramid.empty() || pyramid.getLevel(pyramid.getNumLevels() - 1).coords.size() != 1) {
+        std::cout << "✗ Pyramid does not reduce to a single cell" << std::endl;
+        return false;
+    }
+    
+    double brick_sum = 0.0;
+    float brick_max = 0.0f;
+    for (size_t b = 0; b < field.getNumBricks(); ++b) {
+        brick_sum += field.getBrickSum(b);
+        brick_max = std::max(brick_max, field.getBrickMax(b));
+    }
+    if (pyramid.getMax() != brick_max || std::abs(pyramid.getSum() - brick_sum) > 1e-4 * brick_sum) {
+        std::cout << "✗ Pyramid max/sum " << pyramid.getMax() << "/" << pyramid.getSum()
+                  << " vs " << brick_max << "/" << brick_sum << std::endl;
+        return false;
+    }
+    
+    for (float threshold : {0.05f, 0.3f, 0.8f, 1.5f, 100.0f}) {
+        std::vector<uint32_t> pruned;
+        pyramid.collectBricks(threshold, pruned);
+        std::vector<uint32_t> linear;
+        for (size_t b = 0; b < field.getNumBricks(); ++b) {
+            if (field.getBrickMax(b) >= threshold) {
+                linear.push_back(static_cast<uint32_t>(b));
+            }
+        }
+        if (pruned != linear) {
+            std::cout << "✗ Pyramid selects " << pruned.size() << " bricks at " << threshold
+                      << ", linear scan " << linear.size() << std::endl;
+            return false;
+        }
+        if (analyzer.countDenseVoxels(field, threshold) != analyzer.findDenseRegions(field, threshold).size()) {
+            std::cout << "✗ Dense voxel count disagrees at " << threshold << std::endl;
+            return false;
+        }
+    }
+    
+    std::cout << "✓ " << pyramid.getNumLevels() << " levels over " << field.getNumBricks() << " bricks" << std::endl;
+    return true;
+}
+
+bool testAnisotropicFieldMatchesCovariance() {
+    std::cout << "Testing anisotropic density field against the full covariance..." << std::endl;
+    
+    // Flattened, randomly rotated splats
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> wide(0.05f, 0.15f);
+    std::uniform_real_distribution<float> thin(0.01f, 0.03f);
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int i = 0; i < 150; ++i) {
+        gaussians.emplace_back(
+            Eigen::Vector3f(position(rng), position(rng), position(rng)),
+            Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+            0.8f,
+            Eigen::Vector3f(wide(rng), wide(rng), thin(rng)),
+            Eigen::Quaternionf::UnitRandom()
+        );
+    }
+    
+    AmeScanner::DensityAnalyzer analyzer(0.05f);
+    analyzer.setKernelMode(AmeScanner::DensityAnalyzer::KernelMode::Anisotropic);
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto field = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    
+    std::vector<Eigen::Matrix3f> inverses;
+    for (const auto& gaussian : gaussians) {
+        inverses.push_back(gaussian.computeCovariance().inverse());
+    }
+    
+    // Voxels and batched point queries both match the reference
+    float max_error = 0.0f, max_density = 0.0f;
+    std::vector<Eigen::Vector3f> centers;
+    std::vector<float> expected_densities;
+    for (size_t linear = 0; linear < field.size(); linear += 7) {
+        Eigen::Vector3i voxel(
+            linear % grid_dims.x(),
+            (linear / grid_dims.x()) % grid_dims.y(),
+            linear / (static_cast<size_t>(grid_dims.x()) * grid_dims.y())
+        );
+        Eigen::Vector3f center = min_bounds + (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * 0.05f;
+        float expected = 0.0f;
+        for (size_t g = 0; g < gaussians.size(); ++g) {
+            Eigen::Vector3f d = center - gaussians[g].getPosition();
+            float q = d.dot(inverses[g] * d);
+            if (q <= 9.0f) {
+                expected += gaussians[g].getOpacity() * std::exp(-0.5f * q);
+            }
+        }
+        max_error = std::max(max_error, std::abs(field[linear] - expected));
+        max_density = std::max(max_density, expected);
+        centers.push_back(center);
+        expected_densities.push_back(expected);
+    }
+    auto point_densities = analyzer.computeDensityAtPoints(gaussians, centers);
+    for (size_t i = 0; i < centers.size(); ++i) {
+        max_error = std::max(max_error, std::abs(point_densities[i] - expected_densities[i]));
+    }
+    if (max_error > 1e-3f) {
+        std::cout << "✗ Max voxel error " << max_error << std::endl;
+        return false;
+    }
+    
+    // A thin splat must not smear density off its plane
+    std::vector<AmeScanner::Gaussian> wall = {AmeScanner::Gaussian(
+        Eigen::Vector3f::Zero(), Eigen::Vector3f(1.0f, 1.0f, 1.0f), 1.0f,
+        Eigen::Vector3f(0.2f, 0.2f, 0.01f),
+        Eigen::Quaternionf(Eigen::AngleAxisf(0.7f, Eigen::Vector3f(1.0f, 1.0f, 0.0f).normalized()))
+    )};
+    Eigen::Vector3f normal = wall[0].getRotation() * Eigen::Vector3f::UnitZ();
+    float on_plane = analyzer.computeDensityAtPoint(wall, wall[0].getRotation() * Eigen::Vector3f(0.1f, 0.0f, 0.0f));
+    float off_plane = analyzer.computeDensityAtPoint(wall, 0.05f * normal);
+    if (on_plane < 0.5f || off_plane > 1e-3f) {
+        std::cout << "✗ Thin splat density on/off plane: " << on_plane << " / " << off_plane << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Max voxel error " << max_error << " (peak " << max_density << "), thin splat on/off plane "
+              << on_plane << " / " << off_plane << std::endl;
+    return true;
+}
+
+bool testMappedFieldRoundTrip() {
+    std::cout << "Testing density field file round trip..." << std::endl;
+    
+    auto gaussians = makeScene(23, 300);
+    AmeScanner::DensityAnalyzer analyzer(0.05f);
+    auto field = analyzer.computeSparseDensityField(gaussians);
+    const auto stats = analyzer.getStatistics();
+    
+    const auto path = (std::filesystem::temp_directory_path() / "ame_test_density.amed").string();
+    if (!analyzer.saveDensityField(path, field)) {
+        std::cout << "✗ Failed to save the sparse field" << std::endl;
+        return false;
+    }
+    
+    AmeScanner::MappedDensityField mapped;
+    if (!mapped.open(path)) {
+        std::cout << "✗ Failed to map the sparse field" << std::endl;
+        return false;
+    }
+    const auto& header = mapped.getHeader();
+    if (mapped.getNumBricks() != field.getNumBricks() || mapped.getDims() != field.getDims() ||
+        mapped.getMinBounds() != field.getOrigin() || mapped.getGridSize() != field.getVoxelSize() ||
+        header.median_density != stats.median_density || header.p99_density != stats.p99_density ||
+        header.std_dev_density != stats.std_dev_density) {
+        std::cout << "✗ Header does not match the field and its statistics" << std::endl;
+        return false;
+    }
+    
+    // Every brick must be found by coordinate with identical contents
+    for (size_t b = 0; b < field.getNumBricks(); ++b) {
+        int64_t m = mapped.findBrick(field.getBrickCoord(b));
+        if (m == AmeScanner::SparseDensityField::kNoBrick ||
+            mapped.getBrickMax(m) != field.getBrickMax(b) || mapped.getBrickSum(m) != field.getBrickSum(b) ||
+            !std::equal(field.getBrickValues(b), field.getBrickValues(b) + AmeScanner::SparseDensityField::kBrickVoxels,
+                        mapped.getBrickValues(m))) {
+            std::cout << "✗ Brick " << field.getBrickCoord(b).transpose() << " differs after mapping" << std::endl;
+            return false;
+        }
+    }
+    std::vector<uint32_t> mapped_bricks, field_bricks;
+    mapped.collectBricks(0.5f, mapped_bricks);
+    field.collectBricks(0.5f, field_bricks);
+    if (mapped_bricks.size() != field_bricks.size() || !std::is_sorted(mapped_bricks.begin(), mapped_bricks.end())) {
+        std::cout << "✗ Mapped field selects " << mapped_bricks.size() << " bricks at 0.5, field "
+                  << field_bricks.size() << std::endl;
+        return false;
+    }
+    
+    // The dense grid round-trips voxel for voxel
+    Eigen::Vector3f min_bounds, max_bounds;
+    Eigen::Vector3i grid_dims;
+    auto dense = analyzer.computeDensityField(gaussians, min_bounds, max_bounds, grid_dims);
+    if (!analyzer.saveDensityField(path, dense, min_bounds, max_bounds, grid_dims) || !mapped.open(path)) {
+        std::cout << "✗ Failed to save and map the dense field" << std::endl;
+        return false;
+    }
+    if (mapped.getMaxBounds() != max_bounds) {
+        std::cout << "✗ Dense bounds differ after mapping" << std::endl;
+        return false;
+    }
+    for (int z = 0; z < grid_dims.z(); ++z) {
+        for (int y = 0; y < grid_dims.y(); ++y) {
+            for (int x = 0; x < grid_dims.x(); ++x) {
+                size_t index = x + static_cast<size_t>(y) * grid_dims.x() + static_cast<size_t>(z) * grid_dims.x() * grid_dims.y();
+                if (mapped.getValue(Eigen::Vector3i(x, y, z)) != dense[index]) {
+                    std::cout << "✗ Dense voxel (" << x << ", " << y << ", " << z << ") differs after mapping" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    
+    // A truncated file must be rejected rather than mapped
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4);
+    AmeScanner::MappedDensityField truncated;
+    if (truncated.open(path)) {
+        std::cout << "✗ Truncated file was accepted" << std::endl;
+        return false;
+    }
+    
+    size_t num_bricks = mapped.getNumBricks();
+    mapped.close();
+    std::filesystem::remove(path);
+    
+    std::cout << "✓ " << field.getNumBricks() << " sparse and " << num_bricks << " dense bricks round-tripped" << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Density Analyzer Test ===" << std::endl;
+    
+    bool passed = testDensityFieldMatchesPointEvaluation();
+    passed = testFastExpAccuracy() && passed;
+    passed = testPointDensityMatchesField() && passed;
+    passed = testSparseFieldMatchesDense() && passed;
+    passed = testSparseFieldWithOutlier() && passed;
+    passed = testStatisticsMatchSortedField() && passed;
+    passed = testConnectedRegionsMatchFloodFill() && passed;
+    passed = testPyramidPrunesBricks() && passed;
+    passed = testAnisotropicFieldMatchesCovariance() && passed;
+    passed = testMappedFieldRoundTrip() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <Eigen/Geometry>
+#include "gaussian_attributes.h"
+
+namespace {
+
+std::vector<AmeScanner::Gaussian> makeRandomGaussians(unsigned seed, size_t count) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.005f, 0.2f);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (size_t i = 0; i < count; ++i) {
+        gaussians.emplace_back(
+            Eigen::Vector3f(position(rng), position(rng), position(rng)),
+            Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+            0.5f,
+            Eigen::Vector3f(scale(rng), scale(rng), scale(rng)),
+            Eigen::Quaternionf(Eigen::Vector4f(normal(rng), normal(rng), normal(rng), normal(rng)).normalized())
+        );
+    }
+    return gaussians;
+}
+
+// Row of the table against R diag(s^2) R^T and the ellipsoid's extremes,
+// found by sampling its surface. Returns the largest relative error.
+float rowError(const AmeScanner::GaussianAttributeTable& table, size_t row, const AmeScanner::Gaussian& gaussian,
+               const std::vector<Eigen::Vector3f>& directions) {
+    Eigen::Matrix3f R = gaussian.getRotation().toRotationMatrix();
+    Eigen::Vector3f scale = gaussian.getScale();
+    Eigen::Matrix3f cov = R * scale.cwiseProduct(scale).asDiagonal() * R.transpose();
+    Eigen::Matrix3f inv_cov = R * scale.cwiseProduct(scale).cwiseInverse().asDiagonal() * R.transpose();
+    
+    float error = (table.getCovarianceMatrix(row) - cov).norm() / cov.norm();
+    error = std::max(error, (table.getInverseCovarianceMatrix(row) - inv_cov).norm() / inv_cov.norm());
+    
+    // Surface points k * R * diag(s) * u for unit u
+    const float k = table.getExtentSigmas();
+    float radius = 0.0f;
+    Eigen::Vector3f extent = Eigen::Vector3f::Zero();
+    for (const auto& u : directions) {
+        Eigen::Vector3f p = k * (R * scale.cwiseProduct(u));
+        radius = std::max(radius, p.norm());
+        extent = extent.cwiseMax(p.cwiseAbs());
+    }
+    Eigen::Vector3f table_extent(table.getExtentX()[row], table.getExtentY()[row], table.getExtentZ()[row]);
+    error = std::max(error, std::abs(table.getBoundingRadii()[row] - radius) / radius);
+    error = std::max(error, ((table_extent - extent).cwiseAbs().array() / extent.array()).maxCoeff());
+    return error;
+}
+
+// Fibonacci sphere; sampled extremes fall short of the true ones by
+// well under 0.1%
+std::vector<Eigen::Vector3f> sphereDirections(int count) {
+    std::vector<Eigen::Vector3f> directions;
+    const float golden = static_cast<float>(M_PI) * (3.0f - std::sqrt(5.0f));
+    for (int i = 0; i < count; ++i) {
+        float z = 1.0f - 2.0f * (i + 0.5f) / count;
+        float r = std::sqrt(1.0f - z * z);
+        directions.emplace_back(r * std::cos(golden * i), r * std::sin(golden * i), z);
+    }
+    // Exact axis directions so axis-aligned splats hit their extremes
+    for (int axis = 0; axis < 3; ++axis) {
+        directions.push_back(Eigen::Vector3f::Unit(axis));
+    }
+    return directions;
+}
+
+} // namespace
+
+bool testAttributesMatchReference() {
+    std::cout << "Testing derived attributes against a reference..." << std::endl;
+    
+    auto gaussians = makeRandomGaussians(23, 5000);
+    auto directions = sphereDirections(40000);
+    AmeScanner::GaussianAttributeTable table(2.5f);
+    table.build(gaussians);
+    
+    if (table.size() != gaussians.size() || table.getExtentSigmas() != 2.5f) {
+        std::cout << "✗ Table has " << table.size() << " rows at " << table.getExtentSigmas() << " sigmas" << std::endl;
+        return false;
+    }
+    
+    // Inverse covariances span over 3 orders of magnitude of scale, so
+    // float round-off alone costs ~1e-5 relative
+    float max_error = 0.0f;
+    float max_radius = 0.0f;
+    for (size_t i = 0; i < gaussians.size(); i += 10) {
+        max_error = std::max(max_error, rowError(table, i, gaussians[i], directions));
+    }
+    for (size_t i = 0; i < gaussians.size(); ++i) {
+        max_radius = std::max(max_radius, table.getBoundingRadii()[i]);
+        Eigen::Vector3f offset = gaussians[i].getRotation() * gaussians[i].getScale().cwiseProduct(Eigen::Vector3f(0.6f, 0.0f, 0.8f));
+        float mahalanobis_sq = table.mahalanobisDistanceSq(i, offset);
+        max_error = std::max(max_error, std::abs(mahalanobis_sq - 1.0f));
+    }
+    if (max_error > 1e-3f) {
+        std::cout << "✗ Max relative error " << max_error << std::endl;
+        return false;
+    }
+    if (table.getMaxBoundingRadius() != max_radius) {
+        std::cout << "✗ Max bounding radius " << table.getMaxBoundingRadius() << ", expected " << max_radius << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << table.size() << " rows, max relative error " << max_error << std::endl;
+    return true;
+}
+
+bool testSelectionAndAppend() {
+    std::cout << "\nTesting row selection and append..." << std::endl;
+    
+    auto gaussians = makeRandomGaussians(31, 3000);
+    auto more = makeRandomGaussians(37, 500);
+    std::vector<uint32_t> selection;
+    for (uint32_t i = 0; i < gaussians.size(); i += 3) {
+        selection.push_back(i);
+    }
+    std::vector<uint32_t> more_selection = {499, 0, 250};
+    
+    AmeScanner::GaussianAttributeTable table;
+    table.build(gaussians, selection, 3.0f);
+    table.append(more);
+    table.append(more, more_selection);
+    
+    // Rows follow selection order, then the appended gaussians
+    std::vector<const AmeScanner::Gaussian*> expected;
+    for (uint32_t i : selection) {
+        expected.push_back(&gaussians[i]);
+    }
+    for (const auto& gaussian : more) {
+        expected.push_back(&gaussian);
+    }
+    for (uint32_t i : more_selection) {
+        expected.push_back(&more[i]);
+    }
+    if (table.size() != expected.size()) {
+        std::cout << "✗ Table has " << table.size() << " rows, expected " << expected.size() << std::endl;
+        return false;
+    }
+    
+    AmeScanner::GaussianAttributeTable reference(3.0f);
+    float max_radius = 0.0f;
+    for (size_t row = 0; row < expected.size(); ++row) {
+        reference.build(std::span<const AmeScanner::Gaussian>(expected[row], 1));
+        for (int c = 0; c < 6; ++c) {
+            auto component = static_cast<AmeScanner::GaussianAttributeTable::PackedIndex>(c);
+            if (table.getCovariance(component)[row] != reference.getCovariance(component)[0] ||
+                table.getInverseCovariance(component)[row] != reference.getInverseCovariance(component)[0]) {
+                std::cout << "✗ Row " << row << " does not match its gaussian" << std::endl;
+                return false;
+            }
+        }
+        if (table.getBoundingRadii()[row] != reference.getBoundingRadii()[0]) {
+            std::cout << "✗ Row " << row << " has the wrong bounding radius" << std::endl;
+            return false;
+        }
+        max_radius = std::max(max_radius, table.getBoundingRadii()[row]);
+    }
+    if (table.getMaxBoundingRadius() != max_radius) {
+        std::cout << "✗ Max bounding radius not kept across appends" << std::endl;
+        return false;
+    }
+    
+    // Flat splats keep a finite inverse
+    AmeScanner::Gaussian flat(Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones(), 1.0f,
+                              Eigen::Vector3f(0.1f, 0.1f, 0.0f), Eigen::Quaternionf::Identity());
+    reference.build(std::span<const AmeScanner::Gaussian>(&flat, 1));
+    if (!reference.getInverseCovarianceMatrix(0).allFinite()) {
+        std::cout << "✗ Flat splat has a non-finite inverse covariance" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << table.size() << " rows in selection and append order" << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Gaussian Attributes Test ===" << std::endl;
+    
+    bool passed = testAttributesMatchReference();
+    passed = testSelectionAndAppend() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,427 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <Eigen/Geometry>
+#include "spatial_graph.h"
+#include "thread_pool.h"
+#include "obb_kernels.h"
+
+namespace {
+
+// Random boxes scattered over a room-sized floor, some nested in others
+std::vector<AmeScanner::AmeEntity> makeScene(size_t count, float extent, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::vector<AmeScanner::AmeEntity> entities;
+    for (size_t i = 0; i < count; ++i) {
+        AmeScanner::AmeEntity entity;
+        entity.id = static_cast<uint32_t>(i);
+        entity.physics_handle = entity.id;
+        entity.metaclass = "unknown";
+        if (i % 5 == 4) {
+            // Small box inside the previous one
+            entity.obb = entities.back().obb;
+            entity.obb.extents *= 0.3f;
+        } else {
+            entity.obb.center = Eigen::Vector3f(extent * uniform(rng), 2.0f * uniform(rng), extent * uniform(rng));
+            entity.obb.rotation = Eigen::AngleAxisf(6.28f * uniform(rng), Eigen::Vector3f::UnitY()).toRotationMatrix();
+            entity.obb.extents = Eigen::Vector3f(0.1f + 0.4f * uniform(rng), 0.1f + 0.4f * uniform(rng), 0.1f + 0.4f * uniform(rng));
+        }
+        entities.push_back(entity);
+    }
+    return entities;
+}
+
+bool sameRelationships(const std::vector<AmeScanner::SpatialRelationship>& a, const std::vector<AmeScanner::SpatialRelationship>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].source_id != b[i].source_id || a[i].target_id != b[i].target_id ||
+            a[i].relationship_type != b[i].relationship_type || a[i].confidence != b[i].confidence) {
+            return false;
+        }
+    }
+    return true;
+}
+
+AmeScanner::OBB randomBox(std::mt19937& rng, float spread) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    AmeScanner::OBB obb;
+    obb.center = spread * Eigen::Vector3f(uniform(rng) - 0.5f, uniform(rng) - 0.5f, uniform(rng) - 0.5f);
+    obb.rotation = Eigen::Quaternionf::UnitRandom().toRotationMatrix();
+    obb.extents = Eigen::Vector3f(0.1f + uniform(rng), 0.1f + uniform(rng), 0.1f + uniform(rng));
+    return obb;
+}
+
+Eigen::Vector3d corner(const AmeScanner::OBB& obb, int index) {
+    Eigen::Vector3f local;
+    for (int k = 0; k < 3; ++k) {
+        local[k] = (index >> k & 1) ? obb.extents[k] : -obb.extents[k];
+    }
+    return (obb.center + obb.rotation * local).cast<double>();
+}
+
+double pointBoxDistance(const Eigen::Vector3d& point, const AmeScanner::OBB& obb) {
+    Eigen::Vector3d local = obb.rotation.cast<double>().transpose() * (point - obb.center.cast<double>());
+    return (local.cwiseAbs() - obb.extents.cast<double>()).cwiseMax(0.0).norm();
+}
+
+// Closest distance between segments p1-q1 and p2-q2
+double segmentDistance(const Eigen::Vector3d& p1, const Eigen::Vector3d& q1, const Eigen::Vector3d& p2, const Eigen::Vector3d& q2) {
+    Eigen::Vector3d d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+    double a = d1.squaredNorm(), e = d2.squaredNorm(), f = d2.dot(r);
+    double c = d1.dot(r), b = d1.dot(d2), denom = a * e - b * b;
+    double s = denom > 1e-12 ? std::clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+    double t = (b * s + f) / e;
+    if (t < 0.0) {
+        t = 0.0;
+        s = std::clamp(-c / a, 0.0, 1.0);
+    } else if (t > 1.0) {
+        t = 1.0;
+        s = std::clamp((b - c) / a, 0.0, 1.0);
+    }
+    return (p1 + d1 * s - (p2 + d2 * t)).norm();
+}
+
+// Distance between disjoint boxes: the closest pair is always reached by
+// a corner against the other box or by two edges
+double referenceDistance(const AmeScanner::OBB& a, const AmeScanner::OBB& b) {
+    double best = std::numeric_limits<double>::max();
+    for (int v = 0; v < 8; ++v) {
+        best = std::min(best, pointBoxDistance(corner(a, v), b));
+        best = std::min(best, pointBoxDistance(corner(b, v), a));
+    }
+    for (int u = 0; u < 8; ++u) {
+        for (int ku = 0; ku < 3; ++ku) {
+            if (u >> ku & 1) {
+                continue;
+            }
+            for (int v = 0; v < 8; ++v) {
+                for (int kv = 0; kv < 3; ++kv) {
+                    if (v >> kv & 1) {
+                        continue;
+                    }
+                    best = std::min(best, segmentDistance(corner(a, u), corner(a, u | 1 << ku), corner(b, v), corner(b, v | 1 << kv)));
+                }
+            }
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+bool testBroadPhaseMatchesAllPairs() {
+    std::cout << "Testing broad-phase graph against all pairs..." << std::endl;
+    
+    auto entities = makeScene(600, 12.0f, 3);
+    const float cutoff = 1.5f;
+    const size_t max_neighbors = 6;
+    AmeScanner::SpatialGraph graph;
+    graph.setDirectionalCutoff(cutoff);
+    graph.setMaxDirectionalNeighbors(max_neighbors);
+    graph.buildGraph(entities);
+    
+    // Reference: every ordered pair, the same cutoff and nearest-partner
+    // rules, ordered by source then target
+    std::vector<AmeScanner::SpatialRelationship> expected;
+    for (size_t i = 0; i < entities.size(); ++i) {
+        std::vector<AmeScanner::SpatialRelationship> row;
+        std::vector<std::pair<float, size_t>> directional;
+        for (size_t j = 0; j < entities.size(); ++j) {
+            if (i == j) {
+                continue;
+            }
+            auto relationship = graph.computeRelationship(entities[i], entities[j]);
+            const auto type = relationship.relationship_type;
+            if (type == AmeScanner::RelationshipType::None) {
+                continue;
+            }
+            if (type != AmeScanner::RelationshipType::Contains && type != AmeScanner::RelationshipType::ContainedBy &&
+                type != AmeScanner::RelationshipType::AdjacentTo) {
+                float distance = (entities[i].obb.center - entities[j].obb.center).norm();
+                if (distance > cutoff) {
+                    continue;
+                }
+                directional.emplace_back(distance, row.size());
+            }
+            row.push_back(relationship);
+        }
+        std::sort(directional.begin(), directional.end());
+        std::vector<bool> dropped(row.size(), false);
+        for (size_t k = max_neighbors; k < directional.size(); ++k) {
+            dropped[directional[k].second] = true;
+        }
+        for (size_t r = 0; r < row.size(); ++r) {
+            if (!dropped[r]) {
+                expected.push_back(row[r]);
+            }
+        }
+    }
+    
+    if (!sameRelationships(graph.getRelationships(), expected)) {
+        std::cout << "✗ " << graph.getRelationships().size() << " relationships, expected " << expected.size() << std::endl;
+        return false;
+    }
+    
+    const size_t all_pairs = entities.size() * (entities.size() - 1);
+    if (graph.getStatistics().num_candidate_pairs * 4 > all_pairs) {
+        std::cout << "✗ Broad phase kept " << graph.getStatistics().num_candidate_pairs << " of " << all_pairs << " pairs" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << expected.size() << " relationships from " << graph.getStatistics().num_candidate_pairs
+              << " of " << all_pairs << " pairs" << std::endl;
+    return true;
+}
+
+bool testOBBKernelsMatchReference() {
+    std::cout << "Testing batched OBB kernels against exact references..." << std::endl;
+    
+    std::mt19937 rng(41);
+    const size_t count = 4000;
+    std::vector<AmeScanner::OBB> first, second;
+    for (size_t i = 0; i < count; ++i) {
+        first.push_back(randomBox(rng, 4.0f));
+        if (i % 4 == 0) {
+            // Child box rotated inside its parent, poking out every other time
+            AmeScanner::OBB child = first.back();
+            child.extents *= 0.5f;
+            child.center += first.back().rotation * Eigen::Vector3f(0.2f, -0.1f, 0.15f).cwiseProduct(first.back().extents);
+            if (i % 8 == 0) {
+                child.extents.x() = 0.9f * first.back().extents.x();
+            }
+            second.push_back(child);
+        } else {
+            second.push_back(randomBox(rng, 4.0f));
+        }
+    }
+    
+    std::vector<float> columns[2][AmeScanner::kOBBColumns];
+    float* pointers[2][AmeScanner::kOBBColumns];
+    for (int side = 0; side < 2; ++side) {
+        for (int c = 0; c < AmeScanner::kOBBColumns; ++c) {
+            columns[side][c].resize(count);
+            pointers[side][c] = columns[side][c].data();
+        }
+    }
+    for (size_t i = 0; i < count; ++i) {
+        AmeScanner::packOBB(first[i], pointers[0], i);
+        AmeScanner::packOBB(second[i], pointers[1], i);
+    }
+    std::vector<float> separation(count), distance(count);
+    std::vector<uint8_t> first_contains(count), second_contains(count);
+    auto start = std::chrono::high_resolution_clock::now();
+    AmeScanner::computeOBBPairs(count, pointers[0], pointers[1], separation.data(), distance.data(),
+                                first_contains.data(), second_contains.data());
+    float kernel_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    
+    size_t num_disjoint = 0, num_contained = 0;
+    double max_distance_error = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        // Containment: every corner of one box inside the other
+        bool expected_contains = true, expected_contained = true;
+        for (int v = 0; v < 8; ++v) {
+            Eigen::Vector3d inner = (first[i].rotation.transpose() * (corner(second[i], v).cast<float>() - first[i].center)).cast<double>();
+            Eigen::Vector3d outer = (second[i].rotation.transpose() * (corner(first[i], v).cast<float>() - second[i].center)).cast<double>();
+            expected_contains = expected_contains && (inner.cwiseAbs().array() <= first[i].extents.cast<double>().array() + 1e-5).all();
+            expected_contained = expected_contained && (outer.cwiseAbs().array() <= second[i].extents.cast<double>().array() + 1e-5).all();
+        }
+        if (first_contains[i] != expected_contains || second_contains[i] != expected_contained) {
+            std::cout << "✗ Containment of pair " << i << " is wrong" << std::endl;
+            return false;
+        }
+        num_contained += expected_contains;
+        
+        // Disjoint boxes: the separating-axis gap is a lower bound and the
+        // kernel distance matches the exact one
+        if (separation[i] > 0.0f) {
+            double expected = referenceDistance(first[i], second[i]);
+            ++num_disjoint;
+            if (separation[i] > expected + 1e-4) {
+                std::cout << "✗ Separation " << separation[i] << " exceeds distance " << expected << " for pair " << i << std::endl;
+                return false;
+            }
+            max_distance_error = std::max(max_distance_error, std::abs(distance[i] - expected) / std::max(expected, 1.0));
+        } else if (distance[i] != 0.0f) {
+            std::cout << "✗ Intersecting pair " << i << " at distance " << distance[i] << std::endl;
+            return false;
+        }
+    }
+    
+    if (max_distance_error > 1e-4) {
+        std::cout << "✗ Distance error " << max_distance_error << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << count << " pairs (" << num_disjoint << " disjoint, " << num_contained << " contained) in "
+              << kernel_ms << " ms, max distance error " << max_distance_error << std::endl;
+    return true;
+}
+
+bool testAdjacencyQueries() {
+    std::cout << "Testing CSR adjacency queries..." << std::endl;
+    
+    // Ids differ from indices to check the translation
+    auto entities = makeScene(2000, 20.0f, 11);
+    for (auto& entity : entities) {
+        entity.id += 1000;
+    }
+    AmeScanner::SpatialGraph graph;
+    graph.buildGraph(entities);
+    auto relationships = graph.getRelationships();
+    
+    // Rows reproduce the expanded list, with ascending targets and masks
+    // holding exactly the types present
+    size_t next = 0;
+    for (uint32_t source = 0; source < graph.getNumEntities(); ++source) {
+        auto neighbors = graph.getNeighbors(source);
+        auto types = graph.getNeighborTypes(source);
+        uint16_t mask = 0;
+        for (size_t k = 0; k < neighbors.size(); ++k, ++next) {
+            const auto& relationship = relationships[next];
+            if (relationship.source_id != entities[source].id || relationship.target_id != entities[neighbors[k]].id ||
+                relationship.relationship_type != types[k] || (k > 0 && neighbors[k] <= neighbors[k - 1])) {
+                std::cout << "✗ Row " << source << " disagrees with the relationship list" << std::endl;
+                return false;
+            }
+            mask |= static_cast<uint16_t>(1u << static_cast<int>(types[k]));
+        }
+        if (mask != graph.getTypeMask(source)) {
+            std::cout << "✗ Type mask of row " << source << " is wrong" << std::endl;
+            return false;
+        }
+        
+        size_t above = 0;
+        graph.forEachNeighbor(source, AmeScanner::RelationshipType::Above, [&](uint32_t) { ++above; });
+        if (above != static_cast<size_t>(std::count(types.begin(), types.end(), AmeScanner::RelationshipType::Above))) {
+            std::cout << "✗ forEachNeighbor missed targets of row " << source << std::endl;
+            return false;
+        }
+    }
+    if (next != relationships.size() || graph.getNumRelationships() != relationships.size()) {
+        std::cout << "✗ Rows hold " << next << " of " << relationships.size() << " relationships" << std::endl;
+        return false;
+    }
+    
+    // Old layout: a struct with a heap string per relationship
+    const size_t graph_bytes = graph.getStatistics().graph_bytes;
+    const size_t list_bytes = relationships.size() * (2 * sizeof(uint32_t) + sizeof(std::string) + sizeof(float));
+    if (graph_bytes * 5 > list_bytes) {
+        std::cout << "✗ Graph takes " << graph_bytes << " bytes, the list " << list_bytes << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << relationships.size() << " relationships in " << graph_bytes << " bytes (list: "
+              << list_bytes << ")" << std::endl;
+    return true;
+}
+
+bool testParallelBuildIsDeterministic() {
+    std::cout << "Testing parallel graph build against a single-threaded one..." << std::endl;
+    
+    // Sized explicitly so the pooled build really spreads over workers,
+    // whatever the machine's core count
+    auto entities = makeScene(3000, 25.0f, 17);
+    AmeScanner::ThreadPool::setGlobalThreadCount(4);
+    AmeScanner::SpatialGraph parallel_graph;
+    parallel_graph.buildGraph(entities);
+    
+    AmeScanner::ThreadPool::setGlobalThreadCount(1);
+    AmeScanner::SpatialGraph serial_graph;
+    serial_graph.buildGraph(entities);
+    AmeScanner::ThreadPool::setGlobalThreadCount(0);
+    
+    if (!sameRelationships(parallel_graph.getRelationships(), serial_graph.getRelationships()) ||
+        parallel_graph.getStatistics().num_candidate_pairs != serial_graph.getStatistics().num_candidate_pairs) {
+        std::cout << "✗ Parallel and single-threaded graphs differ" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << parallel_graph.getNumRelationships() << " relationships on 4 threads in "
+              << parallel_graph.getStatistics().build_time_ms << " ms, single-threaded "
+              << serial_graph.getStatistics().build_time_ms << " ms" << std::endl;
+    return true;
+}
+
+bool testIncrementalUpdateMatchesRebuild() {
+    std::cout << "Testing incremental updates against full rebuilds..." << std::endl;
+    
+    auto entities = makeScene(3000, 25.0f, 23);
+    AmeScanner::SpatialGraph graph;
+    graph.buildGraph(entities);
+    
+    // Small edits as in an editing session, then a rescan-sized batch
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(entities.size() - 1));
+    std::uniform_real_distribution<float> step(-0.5f, 0.5f);
+    float total_update_ms = 0.0f, max_update_ms = 0.0f;
+    size_t total_rows = 0;
+    const int rounds = 30;
+    for (int round = 0; round < rounds; ++round) {
+        std::vector<uint32_t> changed;
+        const size_t num_changed = round + 1 < rounds ? 1 + round % 3 : 40;
+        for (size_t k = 0; k < num_changed; ++k) {
+            uint32_t i = pick(rng);
+            changed.push_back(i);
+            auto& obb = entities[i].obb;
+            if (k % 3 == 2) {
+                // Jump into another entity
+                obb.center = entities[pick(rng)].obb.center;
+            } else {
+                obb.center += Eigen::Vector3f(step(rng), 0.2f * step(rng), step(rng));
+            }
+            obb.extents *= 1.0f + 0.2f * step(rng);
+        }
+        
+        if (!graph.updateEntities(entities, changed)) {
+            std::cout << "✗ Update of round " << round << " was rejected" << std::endl;
+            return false;
+        }
+        const auto stats = graph.getStatistics();
+        total_update_ms += stats.update_time_ms;
+        max_update_ms = std::max(max_update_ms, stats.update_time_ms);
+        total_rows += stats.num_updated_rows;
+        
+        AmeScanner::SpatialGraph rebuilt;
+        rebuilt.buildGraph(entities);
+        if (!sameRelationships(graph.getRelationships(), rebuilt.getRelationships())) {
+            std::cout << "✗ Round " << round << ": " << graph.getNumRelationships() << " relationships, rebuild has "
+                      << rebuilt.getNumRelationships() << std::endl;
+            return false;
+        }
+        for (uint32_t source = 0; source < entities.size(); ++source) {
+            if (graph.getTypeMask(source) != rebuilt.getTypeMask(source)) {
+                std::cout << "✗ Round " << round << ": type mask of row " << source << " differs" << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    std::vector<uint32_t> unknown = {static_cast<uint32_t>(entities.size())};
+    if (graph.updateEntities(entities, unknown)) {
+        std::cout << "✗ Update with an unknown entity was accepted" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << rounds << " updates match rebuilds, " << total_rows / rounds << " rows and "
+              << total_update_ms / rounds << " ms per update (max " << max_update_ms << " ms)" << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Spatial Graph Test ===" << std::endl;
+    
+    bool passed = testOBBKernelsMatchReference();
+    passed = testBroadPhaseMatchesAllPairs() && passed;
+    passed = testAdjacencyQueries() && passed;
+    passed = testParallelBuildIsDeterministic() && passed;
+    passed = testIncrementalUpdateMatchesRebuild() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,365 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Geometry>
+#include <Eigen/Eigenvalues>
+#include "surface_extractor.h"
+#include "symmetric_eigen.h"
+
+namespace {
+
+AmeScanner::Gaussian makePoint(const Eigen::Vector3f& position) {
+    return AmeScanner::Gaussian(
+        position,
+        Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+        0.9f,
+        Eigen::Vector3f(0.01f, 0.01f, 0.01f),
+        Eigen::Quaternionf::Identity()
+    );
+}
+
+// Noisy tilted plane next to a sphere shell
+std::vector<AmeScanner::Gaussian> makeSurfaceScene(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 0.002f);
+    
+    const Eigen::Vector3f plane_normal = Eigen::Vector3f(0.2f, 1.0f, 0.1f).normalized();
+    const Eigen::Vector3f u = plane_normal.unitOrthogonal();
+    const Eigen::Vector3f v = plane_normal.cross(u);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int i = 0; i < 3000; ++i) {
+        gaussians.push_back(makePoint(uniform(rng) * u + uniform(rng) * v + noise(rng) * plane_normal));
+    }
+    const Eigen::Vector3f sphere_center(2.5f, 0.0f, 0.0f);
+    for (int i = 0; i < 2000; ++i) {
+        Eigen::Vector3f direction(uniform(rng), uniform(rng), uniform(rng));
+        if (direction.squaredNorm() < 1e-4f) {
+            continue;
+        }
+        gaussians.push_back(makePoint(sphere_center + 0.4f * direction.normalized()));
+    }
+    return gaussians;
+}
+
+} // namespace
+
+bool testSinglePassMatchesPerPoint() {
+    std::cout << "Testing single-pass normals and curvature against per-point queries..." << std::endl;
+    
+    auto gaussians = makeSurfaceScene(5);
+    AmeScanner::SurfaceExtractor extractor;
+    extractor.extractSurfaceCandidates(gaussians);
+    
+    const auto& normals = extractor.getNormals();
+    const auto& curvatures = extractor.getCurvatures();
+    const auto& eigenvalues = extractor.getEigenvalues();
+    if (normals.size() != gaussians.size() || curvatures.size() != gaussians.size() || eigenvalues.size() != gaussians.size()) {
+        std::cout << "✗ Per-gaussian outputs have the wrong size" << std::endl;
+        return false;
+    }
+    
+    float max_curvature_error = 0.0f;
+    float min_alignment = 1.0f;
+    for (size_t i = 0; i < gaussians.size(); i += 7) {
+        Eigen::Vector3f normal = extractor.computeNormal(gaussians, i);
+        float curvature = extractor.computeCurvature(gaussians, i);
+        max_curvature_error = std::max(max_curvature_error, std::abs(curvature - curvatures[i]));
+        min_alignment = std::min(min_alignment, std::abs(normal.dot(normals[i])));
+        
+        if (eigenvalues[i][0] > eigenvalues[i][1] || eigenvalues[i][1] > eigenvalues[i][2]) {
+            std::cout << "✗ Eigenvalues of gaussian " << i << " are not ascending" << std::endl;
+            return false;
+        }
+    }
+    
+    if (max_curvature_error > 1e-3f || min_alignment < 0.999f) {
+        std::cout << "✗ Curvature error " << max_curvature_error << ", normal alignment " << min_alignment << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ Max curvature error " << max_curvature_error << ", min normal alignment " << min_alignment << std::endl;
+    return true;
+}
+
+bool testSplatShapeNormals() {
+    std::cout << "Testing splat-shape normals with neighborhood fallback..." << std::endl;
+    
+    // Flat splats lying in a tilted plane, with round splats mixed in
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    const Eigen::Vector3f plane_normal = Eigen::Vector3f(0.3f, 1.0f, -0.2f).normalized();
+    const Eigen::Vector3f u = plane_normal.unitOrthogonal();
+    const Eigen::Vector3f v = plane_normal.cross(u);
+    const Eigen::Quaternionf in_plane = Eigen::Quaternionf::FromTwoVectors(Eigen::Vector3f::UnitY(), plane_normal);
+    
+    std::vector<AmeScanner::Gaussian> gaussians;
+    size_t num_round = 0;
+    for (int i = 0; i < 4000; ++i) {
+        Eigen::Vector3f position = uniform(rng) * u + uniform(rng) * v;
+        if (i % 10 == 0) {
+            gaussians.push_back(makePoint(position));
+            ++num_round;
+        } else {
+            // Shortest axis is local y, which the rotation maps to the normal
+            gaussians.push_back(AmeScanner::Gaussian(
+                position, Eigen::Vector3f(1.0f, 1.0f, 1.0f), 0.9f,
+                Eigen::Vector3f(0.03f, 0.002f, 0.02f), in_plane
+            ));
+        }
+    }
+    
+    AmeScanner::SurfaceExtractor extractor;
+    extractor.setNormalMode(AmeScanner::SurfaceExtractor::NormalMode::SplatShape);
+    extractor.extractSurfaceCandidates(gaussians);
+    
+    if (extractor.getNumNeighborhoodFallbacks() != num_round) {
+        std::cout << "✗ " << extractor.getNumNeighborhoodFallbacks() << " fallbacks for " << num_round << " round splats" << std::endl;
+        return false;
+    }
+    
+    // Flat splats and the plane points that fell back agree on the normal
+    const auto& normals = extractor.getNormals();
+    const auto& flatness = extractor.getFlatness();
+    float min_alignment = 1.0f;
+    for (size_t i = 0; i < gaussians.size(); ++i) {
+        const bool round = i % 10 == 0;
+        const float expected_flatness = round ? 0.0f : 0.9f;
+        if (std::abs(flatness[i] - expected_flatness) > 1e-5f) {
+            std::cout << "✗ Flatness of gaussian " << i << " is " << flatness[i] << std::endl;
+            return false;
+        }
+        min_alignment = std::min(min_alignment, std::abs(normals[i].dot(plane_normal)));
+        
+        if (i % 13 == 0 && std::abs(extractor.computeNormal(gaussians, i).dot(normals[i])) < 0.999f) {
+            std::cout << "✗ Per-point normal of gaussian " << i << " disagrees" << std::endl;
+            return false;
+        }
+    }
+    if (min_alignment < 0.99f) {
+        std::cout << "✗ Normal off the plane normal, alignment " << min_alignment << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << num_round << " of " << gaussians.size() << " normals from neighborhood PCA, min alignment "
+              << min_alignment << std::endl;
+    return true;
+}
+
+bool testGroupingMatchesBreadthFirst() {
+    std::cout << "Testing union-find grouping against breadth-first search..." << std::endl;
+    
+    // Loose clumps of points; every point is a candidate so the grouping
+    // itself is what gets compared
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int clump = 0; clump < 40; ++clump) {
+        Eigen::Vector3f center = 4.0f * Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng));
+        int size = 2 + clump % 9;
+        for (int i = 0; i < size * 10; ++i) {
+            gaussians.push_back(makePoint(center + 0.15f * Eigen::Vector3f(uniform(rng), uniform(rng), uniform(rng))));
+        }
+    }
+    std::shuffle(gaussians.begin(), gaussians.end(), rng);
+    
+    const float radius = 0.07f;
+    const size_t min_size = 30;
+    AmeScanner::SurfaceExtractor extractor;
+    extractor.setCurvatureThreshold(2.0f);
+    extractor.setGroupingRadius(radius);
+    extractor.setMinRegionSize(min_size);
+    auto regions = extractor.extractSurfaceCandidates(gaussians);
+    
+    // Reference: breadth-first search over brute-force neighbors, members
+    // sorted, regions ordered by first member
+    const size_t n = gaussians.size();
+    std::vector<std::vector<size_t>> expected;
+    std::vector<bool> visited(n, false);
+    for (size_t i = 0; i < n; ++i) {
+        if (visited[i]) {
+            continue;
+        }
+        std::vector<size_t> region = {i};
+        visited[i] = true;
+        for (size_t head = 0; head < region.size(); ++head) {
+            for (size_t j = 0; j < n; ++j) {
+                if (!visited[j] && (gaussians[j].getPosition() - gaussians[region[head]].getPosition()).norm() <= radius) {
+                    visited[j] = true;
+                    region.push_back(j);
+                }
+            }
+        }
+        std::sort(region.begin(), region.end());
+        if (region.size() >= min_size) {
+            expected.push_back(region);
+        }
+    }
+    
+    if (regions != expected) {
+        std::cout << "✗ " << regions.size() << " regions, expected " << expected.size() << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << regions.size() << " regions of at least " << min_size << " points match" << std::endl;
+    return true;
+}
+
+bool testMultiScaleMatchesCubeNeighborhoods() {
+    std::cout << "Testing multi-scale curvature against direct cube neighborhoods..." << std::endl;
+    
+    auto gaussians = makeSurfaceScene(9);
+    const std::vector<float> radii = {0.05f, 0.1f, 0.2f};
+    const float voxel_size = 0.025f;
+    AmeScanner::SurfaceExtractor extractor;
+    if (!extractor.computeMultiScaleCurvatures(gaussians, radii, voxel_size)) {
+        std::cout << "✗ Multi-scale pass failed" << std::endl;
+        return false;
+    }
+    const auto& curvatures = extractor.getMultiScaleCurvatures();
+    if (curvatures.size() != radii.size() || curvatures[0].size() != gaussians.size()) {
+        std::cout << "✗ Multi-scale outputs have the wrong size" << std::endl;
+        return false;
+    }
+    
+    // Reference: covariance of all gaussians whose voxel lies within the
+    // cube around the query's voxel, gathered directly
+    Eigen::Vector3f min_bounds = gaussians[0].getPosition();
+    for (const auto& gaussian : gaussians) {
+        min_bounds = min_bounds.cwiseMin(gaussian.getPosition());
+    }
+    auto voxelOf = [&](size_t i) -> Eigen::Vector3i {
+        return ((gaussians[i].getPosition() - min_bounds) / voxel_size).array().floor().cast<int>();
+    };
+    
+    float max_error = 0.0f;
+    for (size_t scale = 0; scale < radii.size(); ++scale) {
+        const int half_width = static_cast<int>(std::lround(radii[scale] / voxel_size));
+        for (size_t i = 0; i < gaussians.size(); i += 37) {
+            const Eigen::Vector3i voxel = voxelOf(i);
+            Eigen::Vector3d mean = Eigen::Vector3d::Zero();
+            std::vector<Eigen::Vector3d> members;
+            for (size_t j = 0; j < gaussians.size(); ++j) {
+                if ((voxelOf(j) - voxel).cwiseAbs().maxCoeff() <= half_width) {
+                    members.push_back(gaussians[j].getPosition().cast<double>());
+                    mean += members.back();
+                }
+            }
+            
+            float expected = 1.0f;
+            if (members.size() >= 3) {
+                mean /= static_cast<double>(members.size());
+                Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+                for (const auto& member : members) {
+                    covariance += (member - mean) * (member - mean).transpose();
+                }
+                covariance /= static_cast<double>(members.size());
+                Eigen::Vector3d eigenvalues = Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d>(covariance).eigenvalues();
+                expected = eigenvalues[2] < 1e-6 ? 0.0f : static_cast<float>(1.0 - eigenvalues[0] / eigenvalues[2]);
+            }
+            max_error = std::max(max_error, std::abs(curvatures[scale][i] - expected));
+        }
+    }
+    
+    if (max_error > 1e-3f) {
+        std::cout << "✗ Multi-scale curvature off by " << max_error << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << radii.size() << " radii, max curvature error " << max_error << std::endl;
+    return true;
+}
+
+bool testBatchedEigenSolver() {
+    std::cout << "Testing batched eigensolver against Eigen..." << std::endl;
+    
+    // Random rotations of spectra with repeated, zero and tiny eigenvalues;
+    // the count is not a multiple of the batch size
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    const size_t count = 1000;
+    std::vector<Eigen::Matrix3f> matrices;
+    for (size_t i = 0; i < count; ++i) {
+        Eigen::Vector3f spectrum(uniform(rng), uniform(rng), uniform(rng));
+        switch (i % 5) {
+            case 1: spectrum[1] = spectrum[0]; break;
+            case 2: spectrum.head<2>().setZero(); break;
+            case 3: spectrum *= 1e-5f; break;
+            case 4: spectrum *= 1e4f; break;
+        }
+        Eigen::Matrix3f rotation = Eigen::Quaternionf::UnitRandom().toRotationMatrix();
+        matrices.push_back(i % 7 == 0 ? Eigen::Matrix3f(spectrum.asDiagonal())
+                                      : Eigen::Matrix3f(rotation * spectrum.asDiagonal() * rotation.transpose()));
+    }
+    matrices.push_back(Eigen::Matrix3f::Zero());
+    
+    const size_t n = matrices.size();
+    std::vector<float> packed(6 * n), values(3 * n), vectors(9 * n);
+    const int kPacked[6][2] = {{0, 0}, {0, 1}, {0, 2}, {1, 1}, {1, 2}, {2, 2}};
+    const float* packed_columns[6];
+    float* value_columns[3];
+    float* vector_columns[9];
+    for (int c = 0; c < 6; ++c) {
+        for (size_t i = 0; i < n; ++i) {
+            packed[c * n + i] = matrices[i](kPacked[c][0], kPacked[c][1]);
+        }
+        packed_columns[c] = packed.data() + c * n;
+    }
+    for (int k = 0; k < 3; ++k) {
+        value_columns[k] = values.data() + k * n;
+    }
+    for (int c = 0; c < 9; ++c) {
+        vector_columns[c] = vectors.data() + c * n;
+    }
+    AmeScanner::solveSymmetricEigen3(n, packed_columns, value_columns, vector_columns);
+    
+    // Errors relative to the matrix norm: eigenvalues, residual |Av - lv|
+    // and orthonormality of the eigenvector basis
+    float max_value_error = 0.0f, max_residual = 0.0f, max_orthogonality_error = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        const Eigen::Matrix3f& matrix = matrices[i];
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> reference(matrix);
+        Eigen::Matrix3f basis;
+        for (int k = 0; k < 3; ++k) {
+            for (int axis = 0; axis < 3; ++axis) {
+                basis(axis, k) = vectors[(3 * k + axis) * n + i];
+            }
+        }
+        Eigen::Vector3f eigenvalues(values[i], values[n + i], values[2 * n + i]);
+        if (eigenvalues[0] > eigenvalues[1] || eigenvalues[1] > eigenvalues[2]) {
+            std::cout << "✗ Eigenvalues of matrix " << i << " are not ascending" << std::endl;
+            return false;
+        }
+        
+        const float norm = std::max(matrix.norm(), 1e-30f);
+        max_value_error = std::max(max_value_error, (eigenvalues - reference.eigenvalues()).cwiseAbs().maxCoeff() / norm);
+        max_residual = std::max(max_residual, (matrix * basis - basis * eigenvalues.asDiagonal()).norm() / norm);
+        max_orthogonality_error = std::max(max_orthogonality_error, (basis.transpose() * basis - Eigen::Matrix3f::Identity()).norm());
+    }
+    
+    if (max_value_error > 1e-5f || max_residual > 1e-5f || max_orthogonality_error > 1e-5f) {
+        std::cout << "✗ Eigenvalue error " << max_value_error << ", residual " << max_residual
+                  << ", orthogonality error " << max_orthogonality_error << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << n << " matrices, eigenvalue error " << max_value_error << ", residual " << max_residual
+              << ", orthogonality error " << max_orthogonality_error << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Surface Extractor Test ===" << std::endl;
+    
+    bool passed = testSinglePassMatchesPerPoint();
+    passed = testSplatShapeNormals() && passed;
+    passed = testGroupingMatchesBreadthFirst() && passed;
+    passed = testMultiScaleMatchesCubeNeighborhoods() && passed;
+    passed = testBatchedEigenSolver() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
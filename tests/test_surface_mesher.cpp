@@ -0,0 +1,204 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <map>
+#include <cmath>
+#include <filesystem>
+#include <Eigen/Geometry>
+#include "density_analyzer.h"
+#include "surface_mesher.h"
+
+namespace {
+
+AmeScanner::Gaussian makeBlob(const Eigen::Vector3f& center, float sigma, float opacity) {
+    return AmeScanner::Gaussian(
+        center,
+        Eigen::Vector3f(1.0f, 1.0f, 1.0f),
+        opacity,
+        Eigen::Vector3f(sigma, sigma, sigma),
+        Eigen::Quaternionf::Identity()
+    );
+}
+
+// The analyzer bounds the grid by the gaussian centers; faint gaussians at
+// the corners of a box make room for the blobs' tails
+void addBoundsAnchors(std::vector<AmeScanner::Gaussian>& gaussians, const Eigen::Vector3f& center, float half_extent) {
+    gaussians.push_back(makeBlob(center - Eigen::Vector3f::Constant(half_extent), 0.01f, 1e-3f));
+    gaussians.push_back(makeBlob(center + Eigen::Vector3f::Constant(half_extent), 0.01f, 1e-3f));
+}
+
+// Every directed edge is matched by its reverse, so the surface is closed
+// and consistently oriented
+bool isClosed(const AmeScanner::TriangleMesh& mesh) {
+    std::map<std::pair<uint32_t, uint32_t>, int> edges;
+    for (size_t t = 0; t < mesh.getNumTriangles(); ++t) {
+        for (int e = 0; e < 3; ++e) {
+            uint32_t a = mesh.indices[3 * t + e];
+            uint32_t b = mesh.indices[3 * t + (e + 1) % 3];
+            edges[{a, b}]++;
+            edges[{b, a}]--;
+        }
+    }
+    for (const auto& [edge, balance] : edges) {
+        if (balance != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float signedVolume(const AmeScanner::TriangleMesh& mesh) {
+    double volume = 0.0;
+    for (size_t t = 0; t < mesh.getNumTriangles(); ++t) {
+        const auto& a = mesh.vertices[mesh.indices[3 * t]];
+        const auto& b = mesh.vertices[mesh.indices[3 * t + 1]];
+        const auto& c = mesh.vertices[mesh.indices[3 * t + 2]];
+        volume += a.dot(b.cross(c)) / 6.0;
+    }
+    return static_cast<float>(volume);
+}
+
+} // namespace
+
+bool testSphereIsosurface() {
+    std::cout << "Testing isosurface of a single gaussian..." << std::endl;
+    
+    // Density opacity * exp(-r^2 / (2 sigma^2)) reaches the iso level at r0
+    const float sigma = 0.2f, opacity = 1.0f, iso_level = 0.3f;
+    const float r0 = sigma * std::sqrt(2.0f * std::log(opacity / iso_level));
+    const Eigen::Vector3f center(0.13f, -0.07f, 0.21f);
+    std::vector<AmeScanner::Gaussian> gaussians = {makeBlob(center, sigma, opacity)};
+    addBoundsAnchors(gaussians, center, 4.0f * sigma);
+    
+    AmeScanner::DensityAnalyzer analyzer(0.02f);
+    auto field = analyzer.computeSparseDensityField(gaussians);
+    std::vector<int32_t> labels;
+    auto regions = analyzer.labelDenseRegions(field, iso_level, &labels);
+    
+    AmeScanner::SurfaceMesher mesher;
+    auto meshes = mesher.meshRegions(field, labels, regions.size(), iso_level);
+    if (meshes.size() != 1 || meshes[0].empty()) {
+        std::cout << "✗ Expected one non-empty mesh, got " << meshes.size() << std::endl;
+        return false;
+    }
+    const auto& mesh = meshes[0];
+    
+    float max_error = 0.0f;
+    for (const auto& vertex : mesh.vertices) {
+        max_error = std::max(max_error, std::abs((vertex - center).norm() - r0));
+    }
+    if (max_error > 0.5f * field.getVoxelSize()) {
+        std::cout << "✗ Vertex off the sphere by " << max_error << std::endl;
+        return false;
+    }
+    
+    if (!isClosed(mesh)) {
+        std::cout << "✗ Sphere mesh is not closed" << std::endl;
+        return false;
+    }
+    
+    float expected_volume = 4.0f / 3.0f * static_cast<float>(M_PI) * r0 * r0 * r0;
+    float volume = signedVolume(mesh);
+    if (std::abs(volume - expected_volume) > 0.05f * expected_volume) {
+        std::cout << "✗ Enclosed volume " << volume << ", expected " << expected_volume << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << mesh.getNumTriangles() << " triangles, max radius error " << max_error
+              << ", volume " << volume << " / " << expected_volume << std::endl;
+    return true;
+}
+
+bool testRegionsMeshSeparately() {
+    std::cout << "Testing per-region meshes of a random scene..." << std::endl;
+    
+    std::mt19937 rng(29);
+    std::uniform_real_distribution<float> position(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.03f, 0.1f);
+    std::vector<AmeScanner::Gaussian> gaussians;
+    for (int i = 0; i < 150; ++i) {
+        gaussians.push_back(makeBlob(Eigen::Vector3f(position(rng), position(rng), position(rng)), scale(rng), 0.9f));
+    }
+    
+    const float iso_level = 0.25f;
+    AmeScanner::DensityAnalyzer analyzer(0.02f);
+    auto field = analyzer.computeSparseDensityField(gaussians);
+    std::vector<int32_t> labels;
+    auto regions = analyzer.labelDenseRegions(field, iso_level, &labels);
+    
+    AmeScanner::SurfaceMesher mesher;
+    auto meshes = mesher.meshRegions(field, labels, regions.size(), iso_level);
+    if (meshes.size() != regions.size()) {
+        std::cout << "✗ " << meshes.size() << " meshes for " << regions.size() << " regions" << std::endl;
+        return false;
+    }
+    
+    // Each mesh is closed, encloses positive volume and stays within one
+    // voxel of its region's bounds
+    const float voxel = field.getVoxelSize();
+    for (size_t r = 0; r < meshes.size(); ++r) {
+        const auto& mesh = meshes[r];
+        if (mesh.empty() || !isClosed(mesh) || signedVolume(mesh) <= 0.0f) {
+            std::cout << "✗ Mesh of region " << r << " is empty, open or inside out" << std::endl;
+            return false;
+        }
+        for (const auto& vertex : mesh.vertices) {
+            if ((vertex.array() < regions[r].min_bounds.array() - voxel).any() ||
+                (vertex.array() > regions[r].max_bounds.array() + voxel).any()) {
+                std::cout << "✗ Vertex of region " << r << " lies outside its bounds" << std::endl;
+                return false;
+            }
+        }
+    }
+    
+    std::cout << "✓ " << meshes.size() << " closed meshes over " << mesher.getStatistics().num_blocks << " blocks" << std::endl;
+    return true;
+}
+
+bool testMeshFileRoundTrip() {
+    std::cout << "Testing mesh file round trip..." << std::endl;
+    
+    std::vector<AmeScanner::Gaussian> gaussians = {makeBlob(Eigen::Vector3f::Zero(), 0.15f, 1.0f)};
+    addBoundsAnchors(gaussians, Eigen::Vector3f::Zero(), 0.6f);
+    AmeScanner::DensityAnalyzer analyzer(0.01f);
+    auto field = analyzer.computeSparseDensityField(gaussians);
+    std::vector<int32_t> labels;
+    auto regions = analyzer.labelDenseRegions(field, 0.5f, &labels);
+    AmeScanner::SurfaceMesher mesher;
+    auto meshes = mesher.meshRegions(field, labels, regions.size(), 0.5f);
+    
+    const auto path = (std::filesystem::temp_directory_path() / "ame_test_mesh.amesh").string();
+    AmeScanner::TriangleMesh loaded;
+    if (meshes.size() != 1 || !AmeScanner::SurfaceMesher::saveMesh(path, meshes[0]) ||
+        !AmeScanner::SurfaceMesher::loadMesh(path, loaded)) {
+        std::cout << "✗ Failed to save or load the mesh" << std::endl;
+        return false;
+    }
+    if (loaded.vertices != meshes[0].vertices || loaded.indices != meshes[0].indices) {
+        std::cout << "✗ Loaded mesh differs from the saved one" << std::endl;
+        return false;
+    }
+    
+    size_t file_size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, file_size - 2);
+    AmeScanner::TriangleMesh truncated;
+    if (AmeScanner::SurfaceMesher::loadMesh(path, truncated)) {
+        std::cout << "✗ Truncated mesh file was accepted" << std::endl;
+        return false;
+    }
+    std::filesystem::remove(path);
+    
+    std::cout << "✓ " << meshes[0].vertices.size() << " vertices in " << file_size << " bytes" << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Surface Mesher Test ===" << std::endl;
+    
+    bool passed = testSphereIsosurface();
+    passed = testRegionsMeshSeparately() && passed;
+    passed = testMeshFileRoundTrip() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}
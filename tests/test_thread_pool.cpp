@@ -0,0 +1,142 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include "thread_pool.h"
+
+bool testChunkCoverage() {
+    std::cout << "Testing chunk coverage and worker ids..." << std::endl;
+    
+    AmeScanner::ThreadPool pool(4);
+    if (pool.getNumThreads() != 4) {
+        std::cout << "✗ Pool has " << pool.getNumThreads() << " threads, expected 4" << std::endl;
+        return false;
+    }
+    
+    // Every index is visited once, in grain-aligned chunks, by a valid worker.
+    // The sleep keeps chunks pending long enough for the workers to join in.
+    const size_t count = 1000, grain = 16;
+    std::vector<std::atomic<int>> hits(count);
+    std::atomic<bool> bad_chunk{false};
+    std::mutex ids_mutex;
+    std::set<size_t> worker_ids;
+    pool.parallelFor(count, grain, [&](size_t begin, size_t end, size_t worker) {
+        if (begin % grain != 0 || end <= begin || end - begin > grain || end > count || worker >= pool.getNumThreads()) {
+            bad_chunk = true;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            hits[i]++;
+        }
+        {
+            std::lock_guard<std::mutex> lock(ids_mutex);
+            worker_ids.insert(worker);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    });
+    
+    if (bad_chunk) {
+        std::cout << "✗ A chunk was misaligned, oversized or ran on an invalid worker id" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (hits[i] != 1) {
+            std::cout << "✗ Index " << i << " visited " << hits[i] << " times" << std::endl;
+            return false;
+        }
+    }
+    if (worker_ids.size() < 2) {
+        std::cout << "✗ Only " << worker_ids.size() << " worker took part" << std::endl;
+        return false;
+    }
+    
+    // Empty loops never call the body; single-chunk loops run once inline
+    int calls = 0;
+    pool.parallelFor(0, grain, [&](size_t, size_t, size_t) { calls++; });
+    pool.parallelFor(grain, grain, [&](size_t begin, size_t end, size_t worker) {
+        calls += (begin == 0 && end == grain && worker == 0) ? 10 : 100;
+    });
+    if (calls != 10) {
+        std::cout << "✗ Empty or single-chunk loop ran the body incorrectly" << std::endl;
+        return false;
+    }
+    
+    std::cout << "✓ " << count << " indices covered once by " << worker_ids.size() << " workers" << std::endl;
+    return true;
+}
+
+bool testNestedLoopsRunInline() {
+    std::cout << "\nTesting nested loops..." << std::endl;
+    
+    AmeScanner::ThreadPool pool(4);
+    const size_t outer = 16, inner = 100;
+    std::vector<std::atomic<int>> hits(outer * inner);
+    std::atomic<bool> moved{false};
+    pool.parallelFor(outer, 1, [&](size_t begin, size_t end, size_t worker) {
+        const auto thread = std::this_thread::get_id();
+        for (size_t o = begin; o < end; ++o) {
+            pool.parallelFor(inner, 7, [&](size_t inner_begin, size_t inner_end, size_t inner_worker) {
+                if (std::this_thread::get_id() != thread || inner_worker != worker) {
+                    moved = true;
+                }
+                for (size_t i = inner_begin; i < inner_end; ++i) {
+                    hits[o * inner + i]++;
+                }
+            });
+        }
+    });
+    
+    if (moved) {
+        std::cout << "✗ A nested loop left its calling thread or worker id" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < hits.size(); ++i) {
+        if (hits[i] != 1) {
+            std::cout << "✗ Nested index " << i << " visited " << hits[i] << " times" << std::endl;
+            return false;
+        }
+    }
+    
+    std::cout << "✓ " << outer << " nested loops ran inline on their callers" << std::endl;
+    return true;
+}
+
+bool testGlobalThreadCount() {
+    std::cout << "\nTesting global pool sizing..." << std::endl;
+    
+    AmeScanner::ThreadPool::setGlobalThreadCount(3);
+    auto& pool = AmeScanner::ThreadPool::global();
+    if (pool.getNumThreads() != 3) {
+        std::cout << "✗ Global pool has " << pool.getNumThreads() << " threads, expected 3" << std::endl;
+        return false;
+    }
+    std::atomic<size_t> sum{0};
+    std::atomic<bool> bad_worker{false};
+    pool.parallelFor(1000, 10, [&](size_t begin, size_t end, size_t worker) {
+        bad_worker = bad_worker || worker >= 3;
+        for (size_t i = begin; i < end; ++i) {
+            sum += i;
+        }
+    });
+    if (bad_worker || sum != 1000 * 999 / 2) {
+        std::cout << "✗ Loop on the resized global pool went wrong" << std::endl;
+        return false;
+    }
+    
+    AmeScanner::ThreadPool::setGlobalThreadCount(0);
+    std::cout << "✓ Resized to 3 threads, default size " << AmeScanner::ThreadPool::global().getNumThreads() << std::endl;
+    return true;
+}
+
+int main() {
+    std::cout << "=== Thread Pool Test ===" << std::endl;
+    
+    bool passed = testChunkCoverage();
+    passed = testNestedLoopsRunInline() && passed;
+    passed = testGlobalThreadCount() && passed;
+    
+    std::cout << "\n=== Test " << (passed ? "PASSED" : "FAILED") << " ===" << std::endl;
+    return passed ? 0 : 1;
+}